@@ -0,0 +1,271 @@
+int countSetBits(uint64_t mask) {
+#if defined(_MSC_VER) && defined(_M_IX86)
+  // 32-bit x86 has no 64-bit popcount
+  return (int)(__popcnt((uint32_t)mask) + __popcnt((uint32_t)(mask >> 32)));
+#elif defined(_MSC_VER)
+  return (int)__popcnt64(mask);
+#else
+  return __builtin_popcountll(mask);
+#endif
+}
+
+bool isDiggable(Object object) {
+  return object == OBJ_SPACE || object == OBJ_DIRT || object == OBJ_DIAMOND_STATIONARY || object == OBJ_PRE_ROCKFORD_1;
+}
+
+// Spreads reachable cells through passable ones. Rows are spread sideways
+// until they settle, then into the rows next to them, until nothing changes.
+void floodCells(uint64_t reachable[CAVE_HEIGHT], uint64_t passable[CAVE_HEIGHT]) {
+  bool isChanged = true;
+  while (isChanged) {
+    isChanged = false;
+    for (int row = 0; row < CAVE_HEIGHT; ++row) {
+      uint64_t cells = reachable[row];
+      if (row > 0) {
+        cells |= reachable[row-1] & passable[row];
+      }
+      if (row < CAVE_HEIGHT-1) {
+        cells |= reachable[row+1] & passable[row];
+      }
+      for (;;) {
+        uint64_t spread = (cells | (cells << 1) | (cells >> 1)) & passable[row];
+        if (spread == cells) {
+          break;
+        }
+        cells = spread;
+      }
+      if (cells != reachable[row]) {
+        reachable[row] = cells;
+        isChanged = true;
+      }
+    }
+  }
+}
+
+// Cells next to the given ones, and the given ones themselves
+uint64_t getNeighborCells(uint64_t cells[CAVE_HEIGHT], int row) {
+  uint64_t neighbors = cells[row] | (cells[row] << 1) | (cells[row] >> 1);
+  if (row > 0) {
+    neighbors |= cells[row-1];
+  }
+  if (row < CAVE_HEIGHT-1) {
+    neighbors |= cells[row+1];
+  }
+  return neighbors & (((uint64_t)1 << CAVE_WIDTH) - 1);
+}
+
+void analyzeCave(CaveAnalysis *analysis, uint8_t map[CAVE_HEIGHT][CAVE_WIDTH], CaveSurvey *survey) {
+  uint64_t diggable[CAVE_HEIGHT];
+  uint64_t diggableIfBouldersMove[CAVE_HEIGHT];
+  uint64_t diamonds[CAVE_HEIGHT];
+  uint64_t outboxes[CAVE_HEIGHT];
+  uint64_t butterflies[CAVE_HEIGHT];
+  uint64_t boulders[CAVE_HEIGHT];
+  uint64_t magicWalls[CAVE_HEIGHT];
+  uint64_t steelWalls[CAVE_HEIGHT];
+  uint64_t notSteelWalls[CAVE_HEIGHT];
+  uint64_t reachable[CAVE_HEIGHT];
+  uint64_t reachableIfBouldersMove[CAVE_HEIGHT];
+  uint64_t reachableThroughAnything[CAVE_HEIGHT];
+  for (int row = 0; row < CAVE_HEIGHT; ++row) {
+    diggable[row] = diggableIfBouldersMove[row] = 0;
+    diamonds[row] = outboxes[row] = butterflies[row] = boulders[row] = magicWalls[row] = steelWalls[row] = 0;
+    for (int col = 0; col < CAVE_WIDTH; ++col) {
+      Object object = map[row][col];
+      uint64_t cellBit = (uint64_t)1 << col;
+      diggable[row] |= isDiggable(object) ? cellBit : 0;
+      diggableIfBouldersMove[row] |= isDiggable(object) || object == OBJ_BOULDER_STATIONARY ? cellBit : 0;
+      diamonds[row] |= object == OBJ_DIAMOND_STATIONARY ? cellBit : 0;
+      outboxes[row] |= object == OBJ_PRE_OUTBOX ? cellBit : 0;
+      butterflies[row] |= objectInfo[object].update == UPDATE_BUTTERFLY ? cellBit : 0;
+      boulders[row] |= object == OBJ_BOULDER_STATIONARY ? cellBit : 0;
+      magicWalls[row] |= object == OBJ_MAGIC_WALL ? cellBit : 0;
+      steelWalls[row] |= object == OBJ_STEEL_WALL ? cellBit : 0;
+    }
+    notSteelWalls[row] = ~steelWalls[row] & (((uint64_t)1 << CAVE_WIDTH) - 1);
+    reachable[row] = reachableIfBouldersMove[row] = reachableThroughAnything[row] = 0;
+  }
+
+  memset(analysis, 0, sizeof(*analysis));
+  analysis->hasStart = survey->objectCounts[OBJ_PRE_ROCKFORD_1] > 0;
+  analysis->hasOutbox = survey->objectCounts[OBJ_PRE_OUTBOX] > 0;
+  analysis->hasAmoeba = (survey->features & CAVE_HAS_AMOEBA) != 0;
+  if (analysis->hasStart) {
+    reachable[survey->rockfordRow] = (uint64_t)1 << survey->rockfordCol;
+    reachableIfBouldersMove[survey->rockfordRow] = (uint64_t)1 << survey->rockfordCol;
+    reachableThroughAnything[survey->rockfordRow] = (uint64_t)1 << survey->rockfordCol;
+  }
+  floodCells(reachable, diggable);
+  floodCells(reachableIfBouldersMove, diggableIfBouldersMove);
+  // Explosions can open anything but steel wall
+  floodCells(reachableThroughAnything, notSteelWalls);
+
+  // Only butterflies Rockford can get at and boulders he can push into a
+  // magic wall he can get at count
+  uint64_t nearButterflies[CAVE_HEIGHT];
+  bool isMagicWallNear = false;
+  int butterflyCount = 0;
+  for (int row = 0; row < CAVE_HEIGHT; ++row) {
+    nearButterflies[row] = getNeighborCells(reachableIfBouldersMove, row) & butterflies[row];
+    isMagicWallNear |= (getNeighborCells(reachableIfBouldersMove, row) & magicWalls[row]) != 0;
+    butterflyCount += countSetBits(butterflies[row]);
+  }
+
+  bool isOutboxOpen = false;
+  for (int row = 0; row < CAVE_HEIGHT; ++row) {
+    analysis->reachableCellCount += countSetBits(reachable[row]);
+    analysis->reachableDiamonds += countSetBits(reachable[row] & diamonds[row]);
+    analysis->isOutboxReachable |= (getNeighborCells(reachable, row) & outboxes[row]) != 0;
+    analysis->reachableDiamondsIfBouldersMove += countSetBits(reachableIfBouldersMove[row] & diamonds[row]);
+    analysis->isOutboxReachableIfBouldersMove |= (getNeighborCells(reachableIfBouldersMove, row) & outboxes[row]) != 0;
+    isOutboxOpen |= (getNeighborCells(reachableThroughAnything, row) & outboxes[row]) != 0;
+    // A butterfly explodes into diamonds everywhere around it except steel wall
+    analysis->butterflyDiamonds += countSetBits(getNeighborCells(nearButterflies, row) & ~steelWalls[row]);
+    if (isMagicWallNear) {
+      analysis->magicWallDiamonds += countSetBits(reachableIfBouldersMove[row] & boulders[row]);
+    }
+  }
+  analysis->isOutboxEnclosed = analysis->hasStart && analysis->hasOutbox && !isOutboxOpen;
+
+  // Diamonds only come from the ones already there, butterfly explosions,
+  // boulders dropped through a magic wall and amoeba
+  if (analysis->hasAmoeba) {
+    analysis->maxDiamonds = -1;
+  } else {
+    analysis->maxDiamonds = survey->objectCounts[OBJ_DIAMOND_STATIONARY] + 9 * butterflyCount;
+    if (survey->features & CAVE_HAS_MAGIC_WALL) {
+      analysis->maxDiamonds += survey->objectCounts[OBJ_BOULDER_STATIONARY];
+    }
+  }
+}
+
+char *levelVerdictNames[LEVEL_VERDICT_COUNT] = {
+  [LEVEL_OK] = "ok",
+  [LEVEL_NEEDS_BOULDERS_MOVED] = "needs_boulders_moved",
+  [LEVEL_NEEDS_BUTTERFLIES] = "needs_butterflies",
+  [LEVEL_NEEDS_MAGIC_WALL] = "needs_magic_wall",
+  [LEVEL_NEEDS_AMOEBA] = "needs_amoeba",
+  [LEVEL_UNPROVEN] = "unproven",
+  [LEVEL_TOO_FEW_DIAMONDS] = "too_few_diamonds",
+  [LEVEL_OUTBOX_ENCLOSED] = "outbox_enclosed",
+  [LEVEL_NO_OUTBOX] = "no_outbox",
+  [LEVEL_NO_START] = "no_start",
+  [LEVEL_BROKEN] = "broken",
+};
+
+// Each verdict adds one more source of diamonds to the ones before it
+LevelVerdict getLevelVerdict(CaveReport *report, int difficultyLevel) {
+  CaveAnalysis *analysis = &report->analysis;
+  int diamondsNeeded = report->diamondsNeeded[difficultyLevel];
+  if (!report->isValid) {
+    return LEVEL_BROKEN;
+  }
+  if (!analysis->hasStart) {
+    return LEVEL_NO_START;
+  }
+  if (!analysis->hasOutbox) {
+    return LEVEL_NO_OUTBOX;
+  }
+  if (analysis->isOutboxEnclosed) {
+    return LEVEL_OUTBOX_ENCLOSED;
+  }
+  if (analysis->maxDiamonds >= 0 && analysis->maxDiamonds < diamondsNeeded) {
+    return LEVEL_TOO_FEW_DIAMONDS;
+  }
+  if (analysis->isOutboxReachable && analysis->reachableDiamonds >= diamondsNeeded) {
+    return LEVEL_OK;
+  }
+  if (!analysis->isOutboxReachableIfBouldersMove) {
+    return LEVEL_UNPROVEN;
+  }
+  int diamonds = analysis->reachableDiamondsIfBouldersMove;
+  if (diamonds >= diamondsNeeded) {
+    return LEVEL_NEEDS_BOULDERS_MOVED;
+  }
+  diamonds += analysis->butterflyDiamonds;
+  if (diamonds >= diamondsNeeded) {
+    return LEVEL_NEEDS_BUTTERFLIES;
+  }
+  diamonds += analysis->magicWallDiamonds;
+  if (diamonds >= diamondsNeeded) {
+    return LEVEL_NEEDS_MAGIC_WALL;
+  }
+  if (analysis->hasAmoeba) {
+    return LEVEL_NEEDS_AMOEBA;
+  }
+  return LEVEL_UNPROVEN;
+}
+
+bool isCaveReportBad(CaveReport *report) {
+  for (int level = 0; level < NUM_DIFFICULTY_LEVELS; level++) {
+    if (getLevelVerdict(report, level) >= LEVEL_TOO_FEW_DIAMONDS) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void runAnalyzerJob(void *context, int jobIndex, int workerIndex) {
+  Analyzer *analyzer = context;
+  GameState game;
+  memset(&game, 0, sizeof(game));
+
+  int first = jobIndex * CAVES_PER_ANALYZER_JOB;
+  int end = first + CAVES_PER_ANALYZER_JOB;
+  if (end > analyzer->caveCount) {
+    end = analyzer->caveCount;
+  }
+  for (int caveIndex = first; caveIndex < end; caveIndex++) {
+    CaveReport *report = &analyzer->reports[caveIndex];
+    memset(report, 0, sizeof(*report));
+
+    uint8_t *data = analyzer->pack ? getPackCaveData(analyzer->pack, caveIndex) : caveData[caveIndex];
+    if (!data) {
+      continue;
+    }
+    report->isValid = true;
+    memcpy(report->diamondsNeeded, ((CaveInfo *)data)->diamondsNeeded, sizeof(report->diamondsNeeded));
+
+    decodeCave(&game, data);
+    CaveSurvey survey;
+    surveyCave(&survey, game.map);
+    analyzeCave(&report->analysis, game.map, &survey);
+  }
+}
+
+void runAnalyzer(Analyzer *analyzer, int threadCount) {
+  // Builds the random fills before any thread needs them
+  decodeAllCaves();
+
+  int jobCount = (analyzer->caveCount + CAVES_PER_ANALYZER_JOB-1) / CAVES_PER_ANALYZER_JOB;
+  runBatch(runAnalyzerJob, analyzer, jobCount, threadCount);
+}
+
+// One JSON object per line
+void writeCaveReport(FILE *file, CaveReport *report, int caveIndex) {
+  CaveAnalysis *analysis = &report->analysis;
+  fprintf(file, "{\"cave\":%d,\"valid\":%s", caveIndex, report->isValid ? "true" : "false");
+  if (report->isValid) {
+    fprintf(file, ",\"start\":%s,\"outbox\":%s,\"outboxReachable\":%s,\"outboxReachableIfBouldersMove\":%s",
+            analysis->hasStart ? "true" : "false",
+            analysis->hasOutbox ? "true" : "false",
+            analysis->isOutboxReachable ? "true" : "false",
+            analysis->isOutboxReachableIfBouldersMove ? "true" : "false");
+    fprintf(file, ",\"reachableCells\":%d,\"reachableDiamonds\":%d,\"reachableDiamondsIfBouldersMove\":%d",
+            analysis->reachableCellCount, analysis->reachableDiamonds, analysis->reachableDiamondsIfBouldersMove);
+    fprintf(file, ",\"butterflyDiamonds\":%d,\"magicWallDiamonds\":%d,\"amoeba\":%s",
+            analysis->butterflyDiamonds, analysis->magicWallDiamonds, analysis->hasAmoeba ? "true" : "false");
+    fprintf(file, ",\"outboxEnclosed\":%s,\"maxDiamonds\":%d",
+            analysis->isOutboxEnclosed ? "true" : "false", analysis->maxDiamonds);
+    fprintf(file, ",\"diamondsNeeded\":[");
+    for (int level = 0; level < NUM_DIFFICULTY_LEVELS; level++) {
+      fprintf(file, "%s%d", level ? "," : "", report->diamondsNeeded[level]);
+    }
+    fprintf(file, "]");
+  }
+  fprintf(file, ",\"levels\":[");
+  for (int level = 0; level < NUM_DIFFICULTY_LEVELS; level++) {
+    fprintf(file, "%s\"%s\"", level ? "," : "", levelVerdictNames[getLevelVerdict(report, level)]);
+  }
+  fprintf(file, "]}\n");
+}
@@ -0,0 +1,57 @@
+// Static cave analysis: what can be told about a cave from its start
+// position without playing it. Reachable cells are the ones Rockford can dig
+// to from the start without waiting for anything to move. Brick walls that
+// fireflies could open and diamonds that could fall into reach aren't
+// counted, so a cave can be playable even if the analysis can't show it. Only
+// what no amount of play can fix makes a cave bad: broken data, a missing
+// start or outbox, an outbox walled off by steel, or fewer diamonds than a
+// level needs even if every source of diamonds is used up.
+
+#define CAVES_PER_ANALYZER_JOB 64
+
+typedef struct {
+  int reachableCellCount;
+  int reachableDiamonds;
+  bool isOutboxReachable;
+  // Boulders can be pushed, dropped or rolled away, so the same again with
+  // boulders counted as diggable
+  int reachableDiamondsIfBouldersMove;
+  bool isOutboxReachableIfBouldersMove;
+  int butterflyDiamonds;   // cells around butterflies next to that area, when all of them explode
+  int magicWallDiamonds;   // boulders in that area, if a magic wall borders it
+  bool hasAmoeba;          // enclosed amoeba turns into diamonds
+  bool hasStart;
+  bool hasOutbox;
+  bool isOutboxEnclosed;   // steel wall separates the outbox from the start
+  int maxDiamonds;         // no more diamonds can ever be in the cave, -1 if amoeba makes it unbounded
+} CaveAnalysis;
+
+// From best to worst. Everything from LEVEL_TOO_FEW_DIAMONDS on makes the
+// cave bad.
+typedef enum {
+  LEVEL_OK,
+  LEVEL_NEEDS_BOULDERS_MOVED,
+  LEVEL_NEEDS_BUTTERFLIES,
+  LEVEL_NEEDS_MAGIC_WALL,
+  LEVEL_NEEDS_AMOEBA,
+  LEVEL_UNPROVEN, // the analysis can't tell, only playing it can
+  LEVEL_TOO_FEW_DIAMONDS, // even if every source of diamonds is used up
+  LEVEL_OUTBOX_ENCLOSED,
+  LEVEL_NO_OUTBOX,
+  LEVEL_NO_START,
+  LEVEL_BROKEN, // the cave data doesn't decode
+  LEVEL_VERDICT_COUNT,
+} LevelVerdict;
+
+typedef struct {
+  bool isValid;
+  CaveAnalysis analysis;
+  uint8_t diamondsNeeded[NUM_DIFFICULTY_LEVELS];
+} CaveReport;
+
+// Analyzes the caves of a pack, or the original caves if there is no pack
+typedef struct {
+  CavePack *pack;
+  int caveCount;
+  CaveReport *reports;
+} Analyzer;
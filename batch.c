@@ -0,0 +1,193 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+//
+// Atomics
+//
+
+#ifdef _MSC_VER
+bool compareAndSwap64(volatile int64_t *value, int64_t expected, int64_t desired) {
+  return InterlockedCompareExchange64(value, desired, expected) == expected;
+}
+
+int64_t atomicLoad64(volatile int64_t *value) {
+  return InterlockedCompareExchange64(value, 0, 0);
+}
+
+void atomicStore64(volatile int64_t *value, int64_t newValue) {
+  InterlockedExchange64(value, newValue);
+}
+#else
+bool compareAndSwap64(volatile int64_t *value, int64_t expected, int64_t desired) {
+  return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+int64_t atomicLoad64(volatile int64_t *value) {
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+void atomicStore64(volatile int64_t *value, int64_t newValue) {
+  __atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+}
+#endif
+
+int getCoreCount() {
+#ifdef _WIN32
+  SYSTEM_INFO systemInfo;
+  GetSystemInfo(&systemInfo);
+  int count = (int)systemInfo.dwNumberOfProcessors;
+#else
+  int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if (count < 1) {
+    count = 1;
+  }
+  if (count > MAX_BATCH_THREADS) {
+    count = MAX_BATCH_THREADS;
+  }
+  return count;
+}
+
+// The number of workers runBatch uses for the given thread count
+int getBatchWorkerCount(int threadCount) {
+  if (threadCount < 1) {
+    threadCount = 1;
+  }
+  if (threadCount > MAX_BATCH_THREADS) {
+    threadCount = MAX_BATCH_THREADS;
+  }
+  return threadCount;
+}
+
+//
+// Job ranges
+//
+
+int64_t makeJobRange(int begin, int end) {
+  return (int64_t)(((uint64_t)(uint32_t)end << 32) | (uint32_t)begin);
+}
+
+int getJobRangeBegin(int64_t range) {
+  return (int)(uint32_t)range;
+}
+
+int getJobRangeEnd(int64_t range) {
+  return (int)(uint32_t)((uint64_t)range >> 32);
+}
+
+// Takes a job from the front of the worker's own range
+bool takeJob(BatchWorker *worker, int *jobIndex) {
+  for (;;) {
+    int64_t range = atomicLoad64(&worker->jobRange);
+    int begin = getJobRangeBegin(range);
+    int end = getJobRangeEnd(range);
+    if (begin >= end) {
+      return false;
+    }
+    if (compareAndSwap64(&worker->jobRange, range, makeJobRange(begin + 1, end))) {
+      *jobIndex = begin;
+      return true;
+    }
+  }
+}
+
+// Moves the back half of another worker's range to the thief. Returns false
+// when there is nothing left to steal, i.e. every remaining job is already
+// running on some thread.
+bool stealJobs(Batch *batch, int thiefIndex) {
+  BatchWorker *thief = &batch->workers[thiefIndex];
+  for (int i = 1; i < batch->workerCount; ++i) {
+    BatchWorker *victim = &batch->workers[(thiefIndex + i) % batch->workerCount];
+    for (;;) {
+      int64_t range = atomicLoad64(&victim->jobRange);
+      int begin = getJobRangeBegin(range);
+      int end = getJobRangeEnd(range);
+      if (begin >= end) {
+        break;
+      }
+      int middle = begin + (end - begin) / 2;
+      if (compareAndSwap64(&victim->jobRange, range, makeJobRange(begin, middle))) {
+        // Nobody else writes to an empty range, so a plain store is enough
+        atomicStore64(&thief->jobRange, makeJobRange(middle, end));
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void runBatchWorker(Batch *batch, int workerIndex) {
+  BatchWorker *worker = &batch->workers[workerIndex];
+  for (;;) {
+    int jobIndex;
+    if (takeJob(worker, &jobIndex)) {
+      batch->jobFunction(batch->context, jobIndex, workerIndex);
+    } else if (!stealJobs(batch, workerIndex)) {
+      break;
+    }
+  }
+}
+
+#ifdef _WIN32
+DWORD WINAPI batchThreadProc(LPVOID parameter) {
+  BatchThread *thread = (BatchThread *)parameter;
+  runBatchWorker(thread->batch, thread->workerIndex);
+  return 0;
+}
+#else
+void *batchThreadProc(void *parameter) {
+  BatchThread *thread = (BatchThread *)parameter;
+  runBatchWorker(thread->batch, thread->workerIndex);
+  return 0;
+}
+#endif
+
+// Runs jobs [0, jobCount) on threadCount threads and returns when all of them
+// are done. The calling thread works as worker 0.
+void runBatch(BatchJobFunction *jobFunction, void *context, int jobCount, int threadCount) {
+  threadCount = getBatchWorkerCount(threadCount);
+
+  static Batch batch;
+  batch.jobFunction = jobFunction;
+  batch.context = context;
+  batch.workerCount = threadCount;
+  for (int i = 0; i < threadCount; ++i) {
+    int begin = (int)((int64_t)jobCount * i / threadCount);
+    int end = (int)((int64_t)jobCount * (i + 1) / threadCount);
+    batch.workers[i].jobRange = makeJobRange(begin, end);
+  }
+
+  BatchThread threads[MAX_BATCH_THREADS];
+#ifdef _WIN32
+  HANDLE handles[MAX_BATCH_THREADS];
+#else
+  pthread_t handles[MAX_BATCH_THREADS];
+#endif
+
+  for (int i = 1; i < threadCount; ++i) {
+    threads[i].batch = &batch;
+    threads[i].workerIndex = i;
+#ifdef _WIN32
+    handles[i] = CreateThread(0, 0, batchThreadProc, &threads[i], 0, 0);
+    assert(handles[i]);
+#else
+    int error = pthread_create(&handles[i], 0, batchThreadProc, &threads[i]);
+    assert(!error);
+#endif
+  }
+
+  runBatchWorker(&batch, 0);
+
+  for (int i = 1; i < threadCount; ++i) {
+#ifdef _WIN32
+    WaitForSingleObject(handles[i], INFINITE);
+    CloseHandle(handles[i]);
+#else
+    pthread_join(handles[i], 0);
+#endif
+  }
+}
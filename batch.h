@@ -0,0 +1,26 @@
+#define MAX_BATCH_THREADS 64
+
+// Runs one job of a batch. Jobs of a batch are independent of each other and
+// can run on any thread in any order. Jobs on the same worker never overlap,
+// so per-worker state indexed by workerIndex needs no locking.
+typedef void BatchJobFunction(void *context, int jobIndex, int workerIndex);
+
+// Every worker owns a range of job indices. It takes jobs from the front of
+// its own range and, once that is empty, steals the back half of the range of
+// another worker.
+typedef struct {
+  volatile int64_t jobRange; // first job in the low 32 bits, end in the high 32 bits
+  uint8_t padding[56];       // keep workers on separate cache lines
+} BatchWorker;
+
+typedef struct {
+  BatchJobFunction *jobFunction;
+  void *context;
+  int workerCount;
+  BatchWorker workers[MAX_BATCH_THREADS];
+} Batch;
+
+typedef struct {
+  Batch *batch;
+  int workerIndex;
+} BatchThread;
@@ -0,0 +1,7 @@
+#!/bin/sh
+# Builds the headless tools. The game itself is built on Windows with build.bat.
+set -e
+compilerFlags="-std=c11 -O2 -g -Wall -Wno-switch -Wno-return-type -Wno-unused-variable -Wno-missing-braces"
+mkdir -p build
+cc $compilerFlags -pthread simulate.c -o build/simulate
+cc $compilerFlags -Wno-unused-function -fgnu89-inline -Iframe_capture frame_capture/frame_capture.c -o build/frame_capture -lm
@@ -0,0 +1,206 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool isInCave(int row, int col) {
+  return row >= 0 && row < CAVE_HEIGHT && col >= 0 && col < CAVE_WIDTH;
+}
+
+// Walks the explicit object data the way decodeCave does. Returns the size of
+// the whole cave, or 0 if the data runs past maxSize or would place objects
+// outside the cave.
+size_t checkCaveData(uint8_t *data, size_t maxSize) {
+  if (maxSize < sizeof(CaveInfo) + 1) {
+    return 0;
+  }
+  CaveInfo *caveInfo = (CaveInfo *)data;
+  for (int i = 0; i < NUM_RANDOM_OBJECTS; i++) {
+    if (caveInfo->randomObject[i] >= OBJECT_CODE_COUNT) {
+      return 0;
+    }
+  }
+
+  uint8_t *explicitData = data + sizeof(CaveInfo);
+  size_t explicitSize = maxSize - sizeof(CaveInfo);
+  int uselessTopBorderHeight = 2;
+  int ldx[8] = { 0,  1, 1, 1, 0, -1, -1, -1 };
+  int ldy[8] = { -1, -1, 0, 1, 1,  1,  0, -1 };
+  int argumentCount[4] = {
+    [OBJST_SINGLE] = 2,
+    [OBJST_LINE] = 4,
+    [OBJST_FILLED_RECT] = 5,
+    [OBJST_RECT] = 4,
+  };
+
+  size_t i = 0;
+  for (;;) {
+    if (i >= explicitSize) {
+      return 0;
+    }
+    if (explicitData[i] == 0xFF) {
+      break;
+    }
+    ObjectStructure structure = 3 & (explicitData[i] >> 6);
+    if (i + argumentCount[structure] >= explicitSize) {
+      return 0;
+    }
+    uint8_t *arguments = explicitData + i + 1;
+    int col = arguments[0];
+    int row = arguments[1] - uselessTopBorderHeight;
+
+    switch (structure) {
+      case OBJST_SINGLE:
+        if (!isInCave(row, col)) {
+          return 0;
+        }
+        break;
+      case OBJST_LINE: {
+        int length = arguments[2];
+        int direction = arguments[3];
+        if (direction >= 8) {
+          return 0;
+        }
+        if (length > 0 && !(isInCave(row, col) && isInCave(row + (length-1)*ldy[direction], col + (length-1)*ldx[direction]))) {
+          return 0;
+        }
+        break;
+      }
+      case OBJST_FILLED_RECT:
+      case OBJST_RECT: {
+        int width = arguments[2];
+        int height = arguments[3];
+        if (width == 0 || height == 0 || !isInCave(row, col) || !isInCave(row + height-1, col + width-1)) {
+          return 0;
+        }
+        if (structure == OBJST_FILLED_RECT && arguments[4] >= OBJECT_CODE_COUNT) {
+          return 0;
+        }
+        break;
+      }
+    }
+    i += argumentCount[structure] + 1;
+  }
+  return sizeof(CaveInfo) + i + 1;
+}
+
+void closeCavePack(CavePack *pack) {
+#ifdef _WIN32
+  if (pack->data) {
+    UnmapViewOfFile(pack->data);
+  }
+  if (pack->mapping) {
+    CloseHandle(pack->mapping);
+  }
+  if (pack->file && pack->file != INVALID_HANDLE_VALUE) {
+    CloseHandle(pack->file);
+  }
+#else
+  if (pack->data) {
+    munmap(pack->data, pack->size);
+  }
+#endif
+  memset(pack, 0, sizeof(*pack));
+}
+
+// Maps the pack copy-on-write, so games can change their cave info (see
+// DEV_SINGLE_DIAMOND_NEEDED) without touching the file. Only the header and
+// the size of the offset table are checked here.
+bool openCavePack(CavePack *pack, const char *path) {
+  memset(pack, 0, sizeof(*pack));
+
+#ifdef _WIN32
+  pack->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+  LARGE_INTEGER fileSize;
+  if (pack->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(pack->file, &fileSize) ||
+      fileSize.QuadPart < (LONGLONG)sizeof(CavePackHeader)) {
+    closeCavePack(pack);
+    return false;
+  }
+  pack->size = (size_t)fileSize.QuadPart;
+  pack->mapping = CreateFileMappingA(pack->file, 0, PAGE_WRITECOPY, 0, 0, 0);
+  pack->data = pack->mapping ? MapViewOfFile(pack->mapping, FILE_MAP_COPY, 0, 0, 0) : 0;
+  if (!pack->data) {
+    closeCavePack(pack);
+    return false;
+  }
+#else
+  int file = open(path, O_RDONLY);
+  if (file < 0) {
+    return false;
+  }
+  struct stat fileStat;
+  if (fstat(file, &fileStat) != 0 || fileStat.st_size < (off_t)sizeof(CavePackHeader)) {
+    close(file);
+    return false;
+  }
+  pack->size = (size_t)fileStat.st_size;
+  void *data = mmap(0, pack->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+  close(file);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  pack->data = data;
+#endif
+
+  CavePackHeader *header = (CavePackHeader *)pack->data;
+  if (memcmp(header->magic, CAVE_PACK_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != CAVE_PACK_VERSION ||
+      header->caveCount == 0 ||
+      (pack->size - sizeof(CavePackHeader)) / sizeof(uint32_t) < (size_t)header->caveCount + 1) {
+    closeCavePack(pack);
+    return false;
+  }
+  pack->caveCount = header->caveCount;
+  pack->caveOffsets = (uint32_t *)(pack->data + sizeof(CavePackHeader));
+  return true;
+}
+
+// Returns 0 if the cave is broken
+uint8_t *getPackCaveData(CavePack *pack, int caveIndex) {
+  assert(caveIndex >= 0 && (uint32_t)caveIndex < pack->caveCount);
+  size_t caveStart = pack->caveOffsets[caveIndex];
+  size_t caveEnd = pack->caveOffsets[caveIndex+1];
+  size_t dataStart = sizeof(CavePackHeader) + ((size_t)pack->caveCount + 1)*sizeof(uint32_t);
+  if (caveStart < dataStart || caveEnd < caveStart || caveEnd > pack->size) {
+    return 0;
+  }
+  uint8_t *data = pack->data + caveStart;
+  if (!checkCaveData(data, caveEnd - caveStart)) {
+    return 0;
+  }
+  return data;
+}
+
+bool writeCavePack(const char *path, uint8_t **caves, int caveCount) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+
+  CavePackHeader header = {0};
+  memcpy(header.magic, CAVE_PACK_MAGIC, sizeof(header.magic));
+  header.version = CAVE_PACK_VERSION;
+  header.caveCount = (uint32_t)caveCount;
+  bool isWritten = fwrite(&header, sizeof(header), 1, file) == 1;
+
+  uint64_t offset = sizeof(CavePackHeader) + ((uint64_t)caveCount + 1)*sizeof(uint32_t);
+  for (int i = 0; i <= caveCount && isWritten; i++) {
+    uint32_t caveOffset = (uint32_t)offset;
+    isWritten = offset <= UINT32_MAX && fwrite(&caveOffset, sizeof(caveOffset), 1, file) == 1;
+    if (i < caveCount) {
+      offset += checkCaveData(caves[i], SIZE_MAX);
+    }
+  }
+  for (int i = 0; i < caveCount && isWritten; i++) {
+    size_t caveSize = checkCaveData(caves[i], SIZE_MAX);
+    isWritten = caveSize && fwrite(caves[i], caveSize, 1, file) == 1;
+  }
+
+  isWritten = fclose(file) == 0 && isWritten;
+  return isWritten;
+}
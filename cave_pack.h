@@ -0,0 +1,31 @@
+// Cave pack files hold any number of caves in the encoding of the original
+// game. All numbers are little endian:
+//
+//   CavePackHeader
+//   uint32_t caveOffsets[caveCount+1]  cave i spans caveOffsets[i] up to caveOffsets[i+1]
+//   caves                              CaveInfo followed by the explicit object data,
+//                                      up to and including its 0xFF terminator
+//
+// Packs are mapped, not read, and a cave is only checked when a game starts
+// it, so opening a pack takes the same time however many caves it has.
+
+#define CAVE_PACK_MAGIC "BDCP"
+#define CAVE_PACK_VERSION 1
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  uint32_t caveCount;
+  uint32_t reserved;
+} CavePackHeader;
+
+typedef struct {
+  uint8_t *data;
+  size_t size;
+  uint32_t caveCount;
+  uint32_t *caveOffsets;
+#ifdef _WIN32
+  void *file;
+  void *mapping;
+#endif
+} CavePack;
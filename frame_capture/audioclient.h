@@ -0,0 +1,31 @@
+// The part of <audioclient.h> that sound.c uses, see windows.h
+
+#pragma once
+
+#define AUDCLNT_SHAREMODE_SHARED 0
+
+typedef struct IAudioClient IAudioClient;
+typedef struct IAudioRenderClient IAudioRenderClient;
+
+struct IAudioClientVtbl {
+  HRESULT (*GetMixFormat)(IAudioClient *client, WAVEFORMATEX **format);
+  HRESULT (*Initialize)(IAudioClient *client, int shareMode, DWORD flags, REFERENCE_TIME bufferDuration,
+                        REFERENCE_TIME periodicity, WAVEFORMATEX *format, void *sessionGuid);
+  HRESULT (*GetBufferSize)(IAudioClient *client, UINT32 *frameCount);
+  HRESULT (*GetService)(IAudioClient *client, const GUID *iid, void **service);
+  HRESULT (*Start)(IAudioClient *client);
+  HRESULT (*GetCurrentPadding)(IAudioClient *client, UINT32 *frameCount);
+};
+
+struct IAudioClient {
+  struct IAudioClientVtbl *lpVtbl;
+};
+
+struct IAudioRenderClientVtbl {
+  HRESULT (*GetBuffer)(IAudioRenderClient *client, UINT32 frameCount, BYTE **data);
+  HRESULT (*ReleaseBuffer)(IAudioRenderClient *client, UINT32 frameCount, DWORD flags);
+};
+
+struct IAudioRenderClient {
+  struct IAudioRenderClientVtbl *lpVtbl;
+};
@@ -0,0 +1,368 @@
+//
+// Headless frame capture. Builds the Windows game against the small stand-ins
+// for Windows in this directory, runs its main loop for a number of frames
+// with scripted key presses and prints a hash of what the window shows after
+// every frame. Two builds of boulder_dash.c that draw the same pictures print
+// the same lines, so their outputs can be compared with diff.
+//
+// Usage: frame_capture [frames]
+//
+// Every frame is one pass of the message loop. The clock advances by a fixed
+// step whenever it is read, so runs are reproducible. StretchDIBits copies the
+// backbuffer into a window image of palette indices, honouring the clip
+// region, the way GDI would update the real window. A WM_PAINT arrives now and
+// then to exercise full redraws.
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "../boulder_dash.c"
+
+#define CLOCK_FREQUENCY 1000000
+#define CLOCK_STEP 20000
+#define FRAMES_PER_KEY_CHANGE 25
+#define FRAMES_PER_PAINT 997
+#define MAX_CLIP_RECTS 256
+
+typedef struct {
+  int rectCount;
+  RECT rects[MAX_CLIP_RECTS];
+} Region;
+
+// One palette index per backbuffer pixel, the window scale is left out
+uint8_t windowImage[BACKBUFFER_HEIGHT][BACKBUFFER_WIDTH];
+WNDPROC windowProc;
+Region *clipRegion;
+int64_t clockTime;
+long frameCount;
+long maxFrames = 6000;
+
+uint32_t hashBytes(uint8_t *bytes, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+//
+// Window
+//
+
+void *LoadCursor(void *instance, int cursorName) {
+  return 0;
+}
+
+int RegisterClass(WNDCLASS *wndClass) {
+  windowProc = wndClass->lpfnWndProc;
+  return 1;
+}
+
+int AdjustWindowRect(RECT *rect, DWORD style, int hasMenu) {
+  return 1;
+}
+
+HWND CreateWindowEx(DWORD exStyle, LPCSTR className, LPCSTR windowName, DWORD style, int x, int y,
+                    int width, int height, void *parent, void *menu, HINSTANCE instance, void *param) {
+  return (HWND)1;
+}
+
+int ShowWindow(HWND wnd, int cmdShow) {
+  return 1;
+}
+
+int UpdateWindow(HWND wnd) {
+  return 1;
+}
+
+LRESULT DefWindowProc(HWND wnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+  return 0;
+}
+
+void PostQuitMessage(int exitCode) {
+}
+
+// The game drains the queue once per frame, so the first call of a drain
+// starts a new frame. Every frame hands out at most one message.
+int PeekMessage(MSG *msg, HWND wnd, UINT filterMin, UINT filterMax, UINT removeMsg) {
+  static bool isMessageHandedOut;
+  if (isMessageHandedOut) {
+    isMessageHandedOut = false;
+    return 0;
+  }
+
+  if (frameCount > 0) {
+    printf("%ld %08x\n", frameCount, hashBytes(&windowImage[0][0], sizeof(windowImage)));
+  }
+  frameCount++;
+
+  memset(msg, 0, sizeof(*msg));
+  if (frameCount > maxFrames) {
+    msg->message = WM_QUIT;
+  } else if (frameCount % FRAMES_PER_PAINT == 0) {
+    msg->message = WM_PAINT;
+  } else {
+    return 0;
+  }
+  isMessageHandedOut = true;
+  return 1;
+}
+
+int TranslateMessage(MSG *msg) {
+  return 1;
+}
+
+LRESULT DispatchMessage(MSG *msg) {
+  return windowProc(msg->hwnd, msg->message, msg->wParam, msg->lParam);
+}
+
+//
+// Input
+//
+
+HWND GetFocus(void) {
+  return (HWND)1;
+}
+
+// Holds a pseudo-random direction, fire or fail key for a while, then picks
+// another one
+SHORT GetKeyState(int virtKey) {
+  uint32_t state = (uint32_t)(frameCount / FRAMES_PER_KEY_CHANGE) * 2654435761u;
+  state ^= state >> 13;
+  state *= 0x5BD1E995u;
+  state ^= state >> 15;
+
+  bool isDown;
+  switch (virtKey) {
+    case VK_RIGHT: isDown = state % 6 == 0; break;
+    case VK_LEFT:  isDown = state % 6 == 1; break;
+    case VK_DOWN:  isDown = state % 6 == 2; break;
+    case VK_UP:    isDown = state % 6 == 3; break;
+    case VK_SPACE: isDown = (state >> 8) % 7 == 0; break;
+    case 'Q':      isDown = (state >> 12) % 97 == 0; break;
+    default:       isDown = false; break;
+  }
+  return isDown ? (SHORT)0x8000 : 0;
+}
+
+//
+// Drawing
+//
+
+HDC GetDC(HWND wnd) {
+  return (HDC)1;
+}
+
+HDC BeginPaint(HWND wnd, PAINTSTRUCT *paint) {
+  return (HDC)1;
+}
+
+BOOL EndPaint(HWND wnd, const PAINTSTRUCT *paint) {
+  return 1;
+}
+
+HRGN CreateRectRgn(int left, int top, int right, int bottom) {
+  Region *region = calloc(1, sizeof(Region));
+  assert(region);
+  if (right > left && bottom > top) {
+    region->rects[region->rectCount++] = (RECT){left, top, right, bottom};
+  }
+  return region;
+}
+
+// Only the union the game asks for, and the rects may overlap
+int CombineRgn(HRGN destination, HRGN source1, HRGN source2, int mode) {
+  Region *target = destination;
+  Region *added = source2;
+  assert(destination == source1 && mode == RGN_OR);
+  assert(target->rectCount + added->rectCount <= MAX_CLIP_RECTS);
+  for (int i = 0; i < added->rectCount; i++) {
+    target->rects[target->rectCount++] = added->rects[i];
+  }
+  return 1;
+}
+
+int SelectClipRgn(HDC dc, HRGN region) {
+  static Region selectedRegion;
+  if (region) {
+    selectedRegion = *(Region *)region;
+    clipRegion = &selectedRegion;
+  } else {
+    clipRegion = 0;
+  }
+  return 1;
+}
+
+BOOL DeleteObject(HGDIOBJ object) {
+  free(object);
+  return 1;
+}
+
+bool isInClipRegion(int x, int y) {
+  if (!clipRegion) {
+    return true;
+  }
+  for (int i = 0; i < clipRegion->rectCount; i++) {
+    RECT *rect = &clipRegion->rects[i];
+    if (x >= rect->left && x < rect->right && y >= rect->top && y < rect->bottom) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The palette index of a backbuffer pixel in any of the supported formats
+uint8_t getPixelColor(const uint8_t *bits, const BITMAPINFO *bitmapInfo, int pitch, int x, int y) {
+  const uint8_t *row = bits + y*pitch;
+  switch (bitmapInfo->bmiHeader.biBitCount) {
+    case 4:
+      return (x % 2 ? row[x/2] : row[x/2] >> 4) & 0xF;
+    case 8:
+      return row[x];
+    default: {
+      for (int color = 0; color < COLOR_COUNT; color++) {
+        if (memcmp(row + x*4, &bitmapInfo->bmiColors[color], 4) == 0) {
+          return (uint8_t)color;
+        }
+      }
+      return 0xFF;
+    }
+  }
+}
+
+// Copies the whole backbuffer, scaled to the window, wherever the clip region
+// lets it through. Backbuffer rows are top-down.
+int StretchDIBits(HDC dc, int destX, int destY, int destWidth, int destHeight,
+                  int srcX, int srcY, int srcWidth, int srcHeight,
+                  const void *bits, const BITMAPINFO *bitmapInfo, UINT usage, DWORD rop) {
+  assert(srcWidth == BACKBUFFER_WIDTH && srcHeight == BACKBUFFER_HEIGHT);
+  int scale = destWidth / srcWidth;
+  int pitch = (srcWidth*bitmapInfo->bmiHeader.biBitCount/8 + 3) & ~3;
+  for (int y = 0; y < srcHeight; y++) {
+    for (int x = 0; x < srcWidth; x++) {
+      if (isInClipRegion(destX + x*scale, destY + y*scale)) {
+        windowImage[y][x] = getPixelColor(bits, bitmapInfo, pitch, x, y);
+      }
+    }
+  }
+  return srcHeight;
+}
+
+//
+// Time, COM and debugging
+//
+
+int QueryPerformanceFrequency(LARGE_INTEGER *frequency) {
+  frequency->QuadPart = CLOCK_FREQUENCY;
+  return 1;
+}
+
+int QueryPerformanceCounter(LARGE_INTEGER *counter) {
+  clockTime += CLOCK_STEP;
+  counter->QuadPart = clockTime;
+  return 1;
+}
+
+// Audio goes nowhere: the device always reports a nearly full buffer
+
+WAVEFORMATEX mixFormat = {WAVE_FORMAT_PCM, 2, 44100, 44100*4, 4, 16, 0};
+BYTE audioBuffer[1 << 16];
+
+HRESULT getMixFormat(IAudioClient *client, WAVEFORMATEX **format) {
+  *format = &mixFormat;
+  return 0;
+}
+
+HRESULT initializeAudioClient(IAudioClient *client, int shareMode, DWORD flags, REFERENCE_TIME bufferDuration,
+                              REFERENCE_TIME periodicity, WAVEFORMATEX *format, void *sessionGuid) {
+  return 0;
+}
+
+HRESULT getBufferSize(IAudioClient *client, UINT32 *frameCount) {
+  *frameCount = 4096;
+  return 0;
+}
+
+HRESULT getService(IAudioClient *client, const GUID *iid, void **service);
+
+HRESULT startAudioClient(IAudioClient *client) {
+  return 0;
+}
+
+HRESULT getCurrentPadding(IAudioClient *client, UINT32 *frameCount) {
+  *frameCount = 4096 - 64;
+  return 0;
+}
+
+HRESULT getBuffer(IAudioRenderClient *client, UINT32 frameCount, BYTE **data) {
+  assert(frameCount*8 <= sizeof(audioBuffer));
+  *data = audioBuffer;
+  return 0;
+}
+
+HRESULT releaseBuffer(IAudioRenderClient *client, UINT32 frameCount, DWORD flags) {
+  return 0;
+}
+
+struct IAudioClientVtbl audioClientVtbl = {
+  getMixFormat, initializeAudioClient, getBufferSize, getService, startAudioClient, getCurrentPadding,
+};
+IAudioClient audioClient = {&audioClientVtbl};
+struct IAudioRenderClientVtbl renderClientVtbl = {getBuffer, releaseBuffer};
+IAudioRenderClient renderClient = {&renderClientVtbl};
+
+HRESULT getService(IAudioClient *client, const GUID *iid, void **service) {
+  *service = &renderClient;
+  return 0;
+}
+
+HRESULT activateDevice(IMMDevice *device, const GUID *iid, DWORD context, void *params, void **object) {
+  *object = &audioClient;
+  return 0;
+}
+
+struct IMMDeviceVtbl deviceVtbl = {activateDevice};
+IMMDevice device = {&deviceVtbl};
+
+HRESULT getDefaultAudioEndpoint(IMMDeviceEnumerator *enumerator, EDataFlow dataFlow, ERole role, IMMDevice **endpoint) {
+  *endpoint = &device;
+  return 0;
+}
+
+struct IMMDeviceEnumeratorVtbl deviceEnumeratorVtbl = {getDefaultAudioEndpoint};
+IMMDeviceEnumerator deviceEnumerator = {&deviceEnumeratorVtbl};
+
+HRESULT CoInitialize(void *reserved) {
+  return 0;
+}
+
+HRESULT CoCreateInstance(const GUID *clsid, void *outer, DWORD context, const GUID *iid, void **object) {
+  *object = &deviceEnumerator;
+  return 0;
+}
+
+void OutputDebugString(const char *string) {
+}
+
+int vsprintf_s(char *buffer, size_t size, const char *format, va_list args) {
+  return vsnprintf(buffer, size, format, args);
+}
+
+int sprintf_s(char *buffer, size_t size, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, size, format, args);
+  va_end(args);
+  return length;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    maxFrames = atol(argv[1]);
+  }
+  WinMain(0, 0, 0, 0);
+  return 0;
+}
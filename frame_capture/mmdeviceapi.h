@@ -0,0 +1,25 @@
+// The part of <mmdeviceapi.h> that sound.c uses, see windows.h
+
+#pragma once
+
+typedef enum {eRender} EDataFlow;
+typedef enum {eConsole} ERole;
+
+typedef struct IMMDevice IMMDevice;
+typedef struct IMMDeviceEnumerator IMMDeviceEnumerator;
+
+struct IMMDeviceVtbl {
+  HRESULT (*Activate)(IMMDevice *device, const GUID *iid, DWORD context, void *params, void **object);
+};
+
+struct IMMDevice {
+  struct IMMDeviceVtbl *lpVtbl;
+};
+
+struct IMMDeviceEnumeratorVtbl {
+  HRESULT (*GetDefaultAudioEndpoint)(IMMDeviceEnumerator *enumerator, EDataFlow dataFlow, ERole role, IMMDevice **device);
+};
+
+struct IMMDeviceEnumerator {
+  struct IMMDeviceEnumeratorVtbl *lpVtbl;
+};
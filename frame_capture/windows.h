@@ -0,0 +1,175 @@
+// The part of <windows.h> that boulder_dash.c and sound.c use, for building
+// the game on other systems with frame_capture.c standing in for Windows.
+
+#pragma once
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef short SHORT;
+typedef unsigned long DWORD;
+typedef int32_t INT32;
+typedef uint32_t UINT32;
+typedef unsigned int UINT;
+typedef long HRESULT;
+typedef uintptr_t WPARAM;
+typedef intptr_t LPARAM;
+typedef intptr_t LRESULT;
+typedef int64_t REFERENCE_TIME;
+typedef char *LPSTR;
+typedef const char *LPCSTR;
+
+typedef void *HANDLE;
+typedef void *HWND;
+typedef void *HINSTANCE;
+typedef void *HDC;
+typedef void *HRGN;
+typedef void *HGDIOBJ;
+
+typedef struct {
+  unsigned long Data1;
+  unsigned short Data2;
+  unsigned short Data3;
+  unsigned char Data4[8];
+} GUID;
+
+typedef union {
+  int64_t QuadPart;
+} LARGE_INTEGER;
+
+typedef struct {
+  long left;
+  long top;
+  long right;
+  long bottom;
+} RECT;
+
+typedef struct {
+  HWND hwnd;
+  UINT message;
+  WPARAM wParam;
+  LPARAM lParam;
+} MSG;
+
+typedef LRESULT (*WNDPROC)(HWND, UINT, WPARAM, LPARAM);
+
+typedef struct {
+  UINT style;
+  WNDPROC lpfnWndProc;
+  HINSTANCE hInstance;
+  void *hCursor;
+  LPCSTR lpszClassName;
+} WNDCLASS;
+
+typedef struct {
+  HDC hdc;
+  BOOL fErase;
+  RECT rcPaint;
+} PAINTSTRUCT;
+
+typedef struct {
+  BYTE rgbBlue;
+  BYTE rgbGreen;
+  BYTE rgbRed;
+  BYTE rgbReserved;
+} RGBQUAD;
+
+typedef struct {
+  DWORD biSize;
+  long biWidth;
+  long biHeight;
+  WORD biPlanes;
+  WORD biBitCount;
+  DWORD biCompression;
+  DWORD biSizeImage;
+  long biXPelsPerMeter;
+  long biYPelsPerMeter;
+  DWORD biClrUsed;
+  DWORD biClrImportant;
+} BITMAPINFOHEADER;
+
+typedef struct {
+  BITMAPINFOHEADER bmiHeader;
+  RGBQUAD bmiColors[1];
+} BITMAPINFO;
+
+typedef struct {
+  WORD wFormatTag;
+  WORD nChannels;
+  DWORD nSamplesPerSec;
+  DWORD nAvgBytesPerSec;
+  WORD nBlockAlign;
+  WORD wBitsPerSample;
+  WORD cbSize;
+} WAVEFORMATEX;
+
+#define CALLBACK
+#define WINAPI
+#define UNREFERENCED_PARAMETER(parameter) (void)(parameter)
+#define SUCCEEDED(hr) ((hr) >= 0)
+
+#define CS_VREDRAW 0x0001
+#define CS_HREDRAW 0x0002
+#define IDC_ARROW 0
+#define WS_OVERLAPPEDWINDOW 0x00CF0000
+#define WS_VISIBLE 0x10000000
+#define WM_DESTROY 0x0002
+#define WM_PAINT 0x000F
+#define WM_QUIT 0x0012
+#define PM_REMOVE 0x0001
+#define BI_RGB 0
+#define DIB_RGB_COLORS 0
+#define SRCCOPY 0x00CC0020
+#define RGN_OR 2
+#define CLSCTX_ALL 0x17
+#define WAVE_FORMAT_PCM 1
+
+#define VK_ESCAPE 0x1B
+#define VK_SPACE 0x20
+#define VK_LEFT 0x25
+#define VK_UP 0x26
+#define VK_RIGHT 0x27
+#define VK_DOWN 0x28
+
+// Window
+void *LoadCursor(void *instance, int cursorName);
+int RegisterClass(WNDCLASS *wndClass);
+int AdjustWindowRect(RECT *rect, DWORD style, int hasMenu);
+HWND CreateWindowEx(DWORD exStyle, LPCSTR className, LPCSTR windowName, DWORD style, int x, int y,
+                    int width, int height, void *parent, void *menu, HINSTANCE instance, void *param);
+int ShowWindow(HWND wnd, int cmdShow);
+int UpdateWindow(HWND wnd);
+LRESULT DefWindowProc(HWND wnd, UINT msg, WPARAM wParam, LPARAM lParam);
+void PostQuitMessage(int exitCode);
+int PeekMessage(MSG *msg, HWND wnd, UINT filterMin, UINT filterMax, UINT removeMsg);
+int TranslateMessage(MSG *msg);
+LRESULT DispatchMessage(MSG *msg);
+
+// Input
+HWND GetFocus(void);
+SHORT GetKeyState(int virtKey);
+
+// Drawing
+HDC GetDC(HWND wnd);
+HDC BeginPaint(HWND wnd, PAINTSTRUCT *paint);
+BOOL EndPaint(HWND wnd, const PAINTSTRUCT *paint);
+HRGN CreateRectRgn(int left, int top, int right, int bottom);
+int CombineRgn(HRGN destination, HRGN source1, HRGN source2, int mode);
+int SelectClipRgn(HDC dc, HRGN region);
+BOOL DeleteObject(HGDIOBJ object);
+int StretchDIBits(HDC dc, int destX, int destY, int destWidth, int destHeight,
+                  int srcX, int srcY, int srcWidth, int srcHeight,
+                  const void *bits, const BITMAPINFO *bitmapInfo, UINT usage, DWORD rop);
+
+// Time, COM and debugging
+int QueryPerformanceFrequency(LARGE_INTEGER *frequency);
+int QueryPerformanceCounter(LARGE_INTEGER *counter);
+HRESULT CoInitialize(void *reserved);
+HRESULT CoCreateInstance(const GUID *clsid, void *outer, DWORD context, const GUID *iid, void **object);
+void OutputDebugString(const char *string);
+int vsprintf_s(char *buffer, size_t size, const char *format, va_list args);
+int sprintf_s(char *buffer, size_t size, const char *format, ...);
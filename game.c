@@ -0,0 +1,1626 @@
+#ifdef _MSC_VER
+#include <intrin.h>
+#define FORCE_INLINE static __forceinline
+#else
+#define FORCE_INLINE static inline __attribute__((always_inline))
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GAME_SSE2 1
+#include <emmintrin.h>
+#else
+#define GAME_SSE2 0
+#endif
+
+// Cell masks keep one bit per cell, one 64-bit word per cave row
+typedef char caveWidthFitsCellMask[CAVE_WIDTH <= 64 ? 1 : -1];
+typedef char caveHeightFitsRowMask[CAVE_HEIGHT <= 64 ? 1 : -1];
+
+int findLowestSetBit(uint64_t mask) {
+  assert(mask != 0);
+#if defined(_MSC_VER) && defined(_M_IX86)
+  // 32-bit x86 has no 64-bit bit scan
+  unsigned long index;
+  if (_BitScanForward(&index, (uint32_t)mask)) {
+    return (int)index;
+  }
+  _BitScanForward(&index, (uint32_t)(mask >> 32));
+  return (int)index + 32;
+#elif defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, mask);
+  return (int)index;
+#else
+  return __builtin_ctzll(mask);
+#endif
+}
+
+//
+// Map
+//
+
+ObjectInfo objectInfo[OBJECT_CODE_COUNT] = {
+#define X(name, code, properties, unscannedObject, update, nextObject) [name] = {properties, unscannedObject, update, nextObject},
+  OBJECT_LIST(X)
+#undef X
+};
+
+// Every object code has to fit in the table
+#define X(name, code, properties, unscannedObject, update, nextObject) typedef char objectCodeFits_##name[(code) < OBJECT_CODE_COUNT ? 1 : -1];
+OBJECT_LIST(X)
+#undef X
+
+// The scan only visits active and resting objects, so those are exactly the
+// ones that need an update routine
+#define X(name, code, properties, unscannedObject, update, nextObject) \
+  typedef char objectUpdateMatchesProperties_##name[((update) != UPDATE_NONE) == (((properties) & (OBJPROP_ACTIVE | OBJPROP_RESTING)) != 0) ? 1 : -1];
+OBJECT_LIST(X)
+#undef X
+
+// Doesn't compile if two objects share a code
+void checkObjectCodesAreUnique(Object object) {
+  switch (object) {
+#define X(name, code, properties, unscannedObject, update, nextObject) case name: break;
+    OBJECT_LIST(X)
+#undef X
+  }
+}
+
+bool hasObjectProperty(Object object, int property) {
+  assert(object < OBJECT_CODE_COUNT);
+  return (objectInfo[object].properties & property) != 0;
+}
+
+// Active objects can change on their own when the cave is scanned. Everything
+// else (space, dirt, walls, flashing outbox) only changes when something else
+// moves into it, so the scan doesn't need to visit it. Boulders and diamonds
+// at rest are tracked separately, see getLooseCells.
+bool isObjectActive(Object object) {
+  return hasObjectProperty(object, OBJPROP_ACTIVE);
+}
+
+bool isObjectRound(Object object) {
+  return hasObjectProperty(object, OBJPROP_ROUND);
+}
+
+bool isObjectExplosive(Object object) {
+  return hasObjectProperty(object, OBJPROP_EXPLOSIVE);
+}
+
+bool explodesToDiamonds(Object object) {
+  assert(isObjectExplosive(object));
+  return hasObjectProperty(object, OBJPROP_EXPLODES_TO_DIAMONDS);
+}
+
+bool checkFlyExplode(Object object) {
+  return hasObjectProperty(object, OBJPROP_KILLS_FLY);
+}
+
+void setCellBit(uint64_t *mask, uint64_t cellBit, bool isSet) {
+  if (isSet) {
+    *mask |= cellBit;
+  } else {
+    *mask &= ~cellBit;
+  }
+}
+
+//
+// Large caves
+//
+
+// Bits of the cells of a chunk column that are inside the cave
+uint64_t getChunkColumnCells(LargeCave *cave, int chunkCol) {
+  int cellsInChunk = cave->width - chunkCol*CHUNK_SIZE;
+  return cellsInChunk >= CHUNK_SIZE ? ~(uint64_t)0 : ((uint64_t)1 << cellsInChunk) - 1;
+}
+
+// Chunks are filled with steel wall past the right and bottom edge of the cave
+void initLargeCave(LargeCave *cave, int width, int height, Object fillObject) {
+  assert(width > 0 && width <= MAX_LARGE_CAVE_SIZE);
+  assert(height > 0 && height <= MAX_LARGE_CAVE_SIZE);
+  // Unallocated chunks are never visited by the cave scan
+  assert(!isObjectActive(fillObject) && !hasObjectProperty(fillObject, OBJPROP_RESTING));
+
+  memset(cave, 0, sizeof(*cave));
+  cave->width = width;
+  cave->height = height;
+  cave->chunkColumns = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  cave->chunkRows = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  cave->fillObject = fillObject;
+}
+
+void freeLargeCave(LargeCave *cave) {
+  for (int chunkRow = 0; chunkRow < cave->chunkRows; ++chunkRow) {
+    for (int chunkCol = 0; chunkCol < cave->chunkColumns; ++chunkCol) {
+      if (cave->ownedChunks[chunkRow] & ((uint64_t)1 << chunkCol)) {
+        free(cave->chunks[chunkRow][chunkCol]);
+      }
+      cave->chunks[chunkRow][chunkCol] = 0;
+    }
+    cave->ownedChunks[chunkRow] = 0;
+    cave->awakeChunks[chunkRow] = 0;
+    memset(cave->awakeRows[chunkRow], 0, sizeof(cave->awakeRows[chunkRow]));
+  }
+}
+
+// Makes the cave a copy of the original. Chunks are shared with the original
+// until they are written to, so the original must not change in the meantime.
+void restoreLargeCave(LargeCave *cave, LargeCave *original) {
+  freeLargeCave(cave);
+  int scanNumber = cave->scanNumber;
+  *cave = *original;
+  cave->scanNumber = scanNumber;
+  for (int chunkRow = 0; chunkRow < cave->chunkRows; ++chunkRow) {
+    cave->ownedChunks[chunkRow] = 0;
+    cave->awakeChunks[chunkRow] = 0;
+    for (int chunkCol = 0; chunkCol < cave->chunkColumns; ++chunkCol) {
+      if (cave->chunks[chunkRow][chunkCol]) {
+        cave->awakeChunks[chunkRow] |= (uint64_t)1 << chunkCol;
+        cave->awakeRows[chunkRow][chunkCol] = ~(uint64_t)0;
+      } else {
+        cave->awakeRows[chunkRow][chunkCol] = 0;
+      }
+    }
+  }
+}
+
+CaveChunk *getChunk(LargeCave *cave, int row, int chunkCol) {
+  if (row < 0 || row >= cave->height || chunkCol < 0 || chunkCol >= cave->chunkColumns) {
+    return 0;
+  }
+  return cave->chunks[row / CHUNK_SIZE][chunkCol];
+}
+
+Object getLargeCaveCell(LargeCave *cave, int row, int col) {
+  assert(row >= 0 && row < cave->height && col >= 0 && col < cave->width);
+  CaveChunk *chunk = cave->chunks[row / CHUNK_SIZE][col / CHUNK_SIZE];
+  return chunk ? chunk->map[row % CHUNK_SIZE][col % CHUNK_SIZE] : cave->fillObject;
+}
+
+// Cell masks of one chunk row. Unallocated chunks are filled with fillObject,
+// and everything outside the cave is steel wall.
+uint64_t getLargeCaveSpaceCells(LargeCave *cave, int row, int chunkCol) {
+  if (row < 0 || row >= cave->height || chunkCol < 0 || chunkCol >= cave->chunkColumns) {
+    return 0;
+  }
+  CaveChunk *chunk = cave->chunks[row / CHUNK_SIZE][chunkCol];
+  if (chunk) {
+    return chunk->spaceCells[row % CHUNK_SIZE];
+  }
+  return cave->fillObject == OBJ_SPACE ? getChunkColumnCells(cave, chunkCol) : 0;
+}
+
+uint64_t getLargeCaveRoundCells(LargeCave *cave, int row, int chunkCol) {
+  if (row < 0 || row >= cave->height || chunkCol < 0 || chunkCol >= cave->chunkColumns) {
+    return 0;
+  }
+  CaveChunk *chunk = cave->chunks[row / CHUNK_SIZE][chunkCol];
+  if (chunk) {
+    return chunk->roundCells[row % CHUNK_SIZE];
+  }
+  return isObjectRound(cave->fillObject) ? getChunkColumnCells(cave, chunkCol) : 0;
+}
+
+uint64_t getLargeCaveScannedCells(LargeCave *cave, CaveChunk *chunk, int row) {
+  return chunk->scanNumber == cave->scanNumber ? chunk->scannedCells[row % CHUNK_SIZE] : 0;
+}
+
+// Same as getLooseCells, but the neighbouring cells can be in other chunks
+uint64_t getLargeCaveLooseCells(LargeCave *cave, int row, int chunkCol) {
+  CaveChunk *chunk = getChunk(cave, row, chunkCol);
+  uint64_t resting = chunk ? chunk->restingCells[row % CHUNK_SIZE] : 0;
+  if (!resting) {
+    return 0;
+  }
+
+  uint64_t space = getLargeCaveSpaceCells(cave, row, chunkCol);
+  uint64_t spaceBelow = getLargeCaveSpaceCells(cave, row+1, chunkCol);
+  uint64_t spaceToLeft = (space << 1) | (getLargeCaveSpaceCells(cave, row, chunkCol-1) >> 63);
+  uint64_t spaceToRight = (space >> 1) | (getLargeCaveSpaceCells(cave, row, chunkCol+1) << 63);
+  uint64_t spaceBelowToLeft = (spaceBelow << 1) | (getLargeCaveSpaceCells(cave, row+1, chunkCol-1) >> 63);
+  uint64_t spaceBelowToRight = (spaceBelow >> 1) | (getLargeCaveSpaceCells(cave, row+1, chunkCol+1) << 63);
+  uint64_t canRollLeft = spaceToLeft & spaceBelowToLeft;
+  uint64_t canRollRight = spaceToRight & spaceBelowToRight;
+
+  return resting &
+    (spaceBelow | (getLargeCaveRoundCells(cave, row+1, chunkCol) & (canRollLeft | canRollRight)));
+}
+
+void wakeRow(LargeCave *cave, int row, int col) {
+  if (row >= 0 && row < cave->height && col >= 0 && col < cave->width) {
+    cave->awakeChunks[row / CHUNK_SIZE] |= (uint64_t)1 << (col / CHUNK_SIZE);
+    cave->awakeRows[row / CHUNK_SIZE][col / CHUNK_SIZE] |= (uint64_t)1 << (row % CHUNK_SIZE);
+  }
+}
+
+// A changed cell can activate or loosen cells next to it and in the row
+// above, which can belong to the neighbouring chunks
+void wakeRowsAround(LargeCave *cave, int row, int col) {
+  wakeRow(cave, row, col);
+  wakeRow(cave, row-1, col);
+  if (col % CHUNK_SIZE == 0) {
+    wakeRow(cave, row, col-1);
+    wakeRow(cave, row-1, col-1);
+  }
+  if (col % CHUNK_SIZE == CHUNK_SIZE-1) {
+    wakeRow(cave, row, col+1);
+    wakeRow(cave, row-1, col+1);
+  }
+}
+
+void fillChunk(LargeCave *cave, CaveChunk *chunk, int chunkRow, int chunkCol) {
+  memset(chunk, 0, sizeof(*chunk));
+  uint64_t caveCells = getChunkColumnCells(cave, chunkCol);
+  for (int row = 0; row < CHUNK_SIZE; ++row) {
+    bool isRowInCave = chunkRow*CHUNK_SIZE + row < cave->height;
+    for (int col = 0; col < CHUNK_SIZE; ++col) {
+      bool isInCave = isRowInCave && (caveCells & ((uint64_t)1 << col));
+      chunk->map[row][col] = isInCave ? cave->fillObject : OBJ_STEEL_WALL;
+    }
+    if (isRowInCave) {
+      chunk->spaceCells[row] = cave->fillObject == OBJ_SPACE ? caveCells : 0;
+      chunk->roundCells[row] = isObjectRound(cave->fillObject) ? caveCells : 0;
+    }
+  }
+}
+
+// Allocates the chunk or copies it from the original cave on the first write
+CaveChunk *getChunkForWriting(LargeCave *cave, int row, int col) {
+  int chunkRow = row / CHUNK_SIZE;
+  int chunkCol = col / CHUNK_SIZE;
+  uint64_t chunkBit = (uint64_t)1 << chunkCol;
+  CaveChunk *chunk = cave->chunks[chunkRow][chunkCol];
+
+  if (!(cave->ownedChunks[chunkRow] & chunkBit)) {
+    CaveChunk *newChunk = malloc(sizeof(CaveChunk));
+    assert(newChunk);
+    if (chunk) {
+      *newChunk = *chunk;
+    } else {
+      fillChunk(cave, newChunk, chunkRow, chunkCol);
+    }
+    chunk = newChunk;
+    cave->chunks[chunkRow][chunkCol] = chunk;
+    cave->ownedChunks[chunkRow] |= chunkBit;
+  }
+
+  if (chunk->scanNumber != cave->scanNumber) {
+    memset(chunk->scannedCells, 0, sizeof(chunk->scannedCells));
+    chunk->scanNumber = cave->scanNumber;
+  }
+
+  return chunk;
+}
+
+void setLargeCaveCell(LargeCave *cave, int row, int col, Object object) {
+  assert(row >= 0 && row < cave->height && col >= 0 && col < cave->width);
+  CaveChunk *chunk = getChunkForWriting(cave, row, col);
+  int chunkMaskRow = row % CHUNK_SIZE;
+  uint64_t cellBit = (uint64_t)1 << (col % CHUNK_SIZE);
+  chunk->map[chunkMaskRow][col % CHUNK_SIZE] = object;
+  chunk->scannedCells[chunkMaskRow] &= ~cellBit;
+  setCellBit(&chunk->activeCells[chunkMaskRow], cellBit, isObjectActive(object));
+  setCellBit(&chunk->spaceCells[chunkMaskRow], cellBit, object == OBJ_SPACE);
+  setCellBit(&chunk->roundCells[chunkMaskRow], cellBit, isObjectRound(object));
+  setCellBit(&chunk->restingCells[chunkMaskRow], cellBit, hasObjectProperty(object, OBJPROP_RESTING));
+  wakeRowsAround(cave, row, col);
+}
+
+//
+// Cells
+//
+
+Object getCell(GameState *game, int row, int col) {
+  if (game->largeCave) {
+    return getLargeCaveCell(game->largeCave, row, col);
+  }
+  return game->map[row][col];
+}
+
+void setCell(GameState *game, int row, int col, Object object) {
+  if (game->largeCave) {
+    setLargeCaveCell(game->largeCave, row, col, object);
+    return;
+  }
+
+  uint64_t cellBit = (uint64_t)1 << col;
+  game->map[row][col] = object;
+  game->scannedCells[row] &= ~cellBit;
+  setCellBit(&game->activeCells[row], cellBit, isObjectActive(object));
+  setCellBit(&game->spaceCells[row], cellBit, object == OBJ_SPACE);
+  setCellBit(&game->roundCells[row], cellBit, isObjectRound(object));
+  setCellBit(&game->restingCells[row], cellBit, hasObjectProperty(object, OBJPROP_RESTING));
+  setCellBit(&game->amoebaCanGrowCells[row], cellBit, hasObjectProperty(object, OBJPROP_AMOEBA_CAN_GROW));
+
+  // The change can activate or loosen cells in this row and the one above
+  game->awakeRows |= ((uint64_t)1 << row) | ((uint64_t)1 << row >> 1);
+}
+
+// Sets all cell masks from the map, for code that writes the map directly
+void rebuildCellMasks(GameState *game) {
+  for (int row = 0; row < CAVE_HEIGHT; ++row) {
+    uint64_t active = 0, space = 0, round = 0, resting = 0, amoebaCanGrow = 0;
+    for (int col = 0; col < CAVE_WIDTH; ++col) {
+      Object object = game->map[row][col];
+      uint64_t cellBit = (uint64_t)1 << col;
+      active |= isObjectActive(object) ? cellBit : 0;
+      space |= object == OBJ_SPACE ? cellBit : 0;
+      round |= isObjectRound(object) ? cellBit : 0;
+      resting |= hasObjectProperty(object, OBJPROP_RESTING) ? cellBit : 0;
+      amoebaCanGrow |= hasObjectProperty(object, OBJPROP_AMOEBA_CAN_GROW) ? cellBit : 0;
+    }
+    game->activeCells[row] = active;
+    game->spaceCells[row] = space;
+    game->roundCells[row] = round;
+    game->restingCells[row] = resting;
+    game->amoebaCanGrowCells[row] = amoebaCanGrow;
+    game->scannedCells[row] = 0;
+  }
+  game->awakeRows = ((uint64_t)1 << CAVE_HEIGHT) - 1;
+}
+
+// Puts an object that has already been updated this turn, so the rest of the
+// cave scan leaves it alone
+void setScannedCell(GameState *game, int row, int col, Object object) {
+  setCell(game, row, col, object);
+  if (game->largeCave) {
+    CaveChunk *chunk = game->largeCave->chunks[row / CHUNK_SIZE][col / CHUNK_SIZE];
+    chunk->scannedCells[row % CHUNK_SIZE] |= (uint64_t)1 << (col % CHUNK_SIZE);
+  } else {
+    game->scannedCells[row] |= (uint64_t)1 << col;
+  }
+}
+
+// Cave data can contain the scanned object codes of the original game. The
+// simulation keeps the scanned status in GameState.scannedCells instead.
+Object getUnscannedObject(Object object) {
+  if (hasObjectProperty(object, OBJPROP_SCANNED)) {
+    return objectInfo[object].unscannedObject;
+  }
+  return object;
+}
+
+// Returns boulders and diamonds at rest in the row that are going to fall or
+// roll off when scanned. The rest of them would stay where they are.
+uint64_t getLooseCells(GameState *game, int row) {
+  if (row+1 >= CAVE_HEIGHT) {
+    return 0;
+  }
+
+  uint64_t space = game->spaceCells[row];
+  uint64_t spaceBelow = game->spaceCells[row+1];
+  uint64_t canRollLeft = (space << 1) & (spaceBelow << 1);
+  uint64_t canRollRight = (space >> 1) & (spaceBelow >> 1);
+
+  return game->restingCells[row] &
+    (spaceBelow | (game->roundCells[row+1] & (canRollLeft | canRollRight)));
+}
+
+//
+// Cave decoding
+//
+
+void nextRandom(int *randSeed1, int *randSeed2) {
+  int tempRand1 = (*randSeed1 & 0x0001) * 0x0080;
+  int tempRand2 = (*randSeed2 >> 1) & 0x007F;
+
+  int result = (*randSeed2) + (*randSeed2 & 0x0001) * 0x0080;
+  int carry = (result > 0x00FF);
+  result = result & 0x00FF;
+
+  result = result + carry + 0x13;
+  carry = (result > 0x00FF);
+  *randSeed2 = result & 0x00FF;
+
+  result = *randSeed1 + carry + tempRand1;
+  carry = (result > 0x00FF);
+  result = result & 0x00FF;
+
+  result = result + carry + tempRand2;
+  *randSeed1 = result & 0x00FF;
+}
+
+#define RANDOM_FILL_CELLS ((CAVE_HEIGHT-1)*CAVE_WIDTH)
+
+// The random fill only depends on the randomiser seed, and nextRandom has
+// just 256 starting states for it. The numbers the fill compares against the
+// object probabilities are worked out once for every seed. Built on first
+// use, see getDecodedCave about threads.
+uint8_t randomFills[256][RANDOM_FILL_CELLS];
+bool areRandomFillsBuilt;
+
+uint8_t *getRandomFill(uint8_t randomiserSeed) {
+  if (!areRandomFillsBuilt) {
+    for (int seed = 0; seed < 256; seed++) {
+      int randSeed1 = 0;
+      int randSeed2 = seed;
+      for (int i = 0; i < RANDOM_FILL_CELLS; i++) {
+        nextRandom(&randSeed1, &randSeed2);
+        randomFills[seed][i] = (uint8_t)randSeed1;
+      }
+    }
+    areRandomFillsBuilt = true;
+  }
+  return randomFills[randomiserSeed];
+}
+
+// A cell gets the last random object whose probability is above the cell's
+// random number, or dirt if there is none
+void fillRandomObjects(uint8_t *objects, uint8_t *randoms, int count, CaveInfo *caveInfo) {
+  uint8_t randomObjects[NUM_RANDOM_OBJECTS];
+  for (int i = 0; i < NUM_RANDOM_OBJECTS; i++) {
+    randomObjects[i] = getUnscannedObject(caveInfo->randomObject[i]);
+  }
+
+  int cell = 0;
+#if GAME_SSE2
+  // There is no unsigned byte compare, flipping the top bit makes a signed
+  // compare give the same result
+  __m128i bias = _mm_set1_epi8((char)0x80);
+  for (; cell + 16 <= count; cell += 16) {
+    __m128i random = _mm_xor_si128(_mm_loadu_si128((__m128i *)(randoms + cell)), bias);
+    __m128i result = _mm_set1_epi8(OBJ_DIRT);
+    for (int i = 0; i < NUM_RANDOM_OBJECTS; i++) {
+      __m128i probability = _mm_set1_epi8((char)(caveInfo->objectProbability[i] ^ 0x80));
+      __m128i isBelow = _mm_cmplt_epi8(random, probability);
+      result = _mm_or_si128(_mm_andnot_si128(isBelow, result), _mm_and_si128(isBelow, _mm_set1_epi8((char)randomObjects[i])));
+    }
+    _mm_storeu_si128((__m128i *)(objects + cell), result);
+  }
+#endif
+  for (; cell < count; cell++) {
+    uint8_t object = OBJ_DIRT;
+    for (int i = 0; i < NUM_RANDOM_OBJECTS; i++) {
+      if (randoms[cell] < caveInfo->objectProbability[i]) {
+        object = randomObjects[i];
+      }
+    }
+    objects[cell] = object;
+  }
+}
+
+void placeObjectLine(GameState *game, Object object, int row, int col, int length, int direction) {
+  int ldx[8] = { 0,  1, 1, 1, 0, -1, -1, -1 };
+  int ldy[8] = { -1, -1, 0, 1, 1,  1,  0, -1 };
+
+  for (int i = 0; i < length; i++) {
+    setCell(game, row + i*ldy[direction], col + i*ldx[direction], object);
+  }
+}
+
+void placeObjectFilledRect(GameState *game, Object object, int row, int col, int width, int height, Object fillObject) {
+  for (int x = 0; x < width; x++) {
+    for (int y = 0; y < height; y++) {
+      if (y == 0 || y == height-1 || x == 0 || x == width-1) {
+        setCell(game, row+y, col+x, object);
+      } else {
+        setCell(game, row+y, col+x, fillObject);
+      }
+    }
+  }
+}
+
+void placeObjectRect(GameState *game, Object object, int row, int col, int width, int height) {
+  for (int i = 0; i < width; i++) {
+    setCell(game, row, col+i, object);
+    setCell(game, row+height-1, col+i, object);
+  }
+  for (int i = 0; i < height; i++) {
+    setCell(game, row+i, col, object);
+    setCell(game, row+i, col+width-1, object);
+  }
+}
+
+uint8_t *caveData[CAVE_COUNT] = {
+  caveA, caveB, caveC, caveD, intermission1,
+  caveE, caveF, caveG, caveH, intermission2,
+  caveI, caveJ, caveK, caveL, intermission3,
+  caveM, caveN, caveO, caveP, intermission4,
+};
+
+CaveInfo *getCaveInfo(int caveIndex) {
+  assert(caveIndex >= 0 && caveIndex < CAVE_COUNT);
+  return (CaveInfo *)caveData[caveIndex];
+}
+
+// Decodes a cave in the encoding of the original game, a CaveInfo followed by
+// the explicit object data
+void decodeCave(GameState *game, uint8_t *data) {
+  game->caveInfo = (CaveInfo *)data;
+
+  // Decode random map objects, the top row stays steel wall. The map is
+  // written directly, the rest of the decoding goes through setCell.
+  memset(game->map[0], OBJ_STEEL_WALL, CAVE_WIDTH);
+  fillRandomObjects(game->map[1], getRandomFill(game->caveInfo->randomiserSeed[0]), RANDOM_FILL_CELLS, game->caveInfo);
+  rebuildCellMasks(game);
+
+  // Steel bounds
+  placeObjectRect(game, OBJ_STEEL_WALL, 0, 0, CAVE_WIDTH, CAVE_HEIGHT);
+
+  // Decode explicit map data
+  {
+    uint8_t *explicitData = data + sizeof(CaveInfo);
+    int uselessTopBorderHeight = 2;
+
+    for (int i = 0; explicitData[i] != 0xFF; i++) {
+      Object object = getUnscannedObject(explicitData[i] & 0x3F);
+
+      switch (3 & (explicitData[i] >> 6)) {
+        case OBJST_SINGLE: {
+          int col = explicitData[++i];
+          int row = explicitData[++i] - uselessTopBorderHeight;
+          setCell(game, row, col, object);
+          break;
+        }
+        case OBJST_LINE: {
+          int col = explicitData[++i];
+          int row = explicitData[++i] - uselessTopBorderHeight;
+          int length = explicitData[++i];
+          int direction = explicitData[++i];
+          placeObjectLine(game, object, row, col, length, direction);
+          break;
+        }
+        case OBJST_FILLED_RECT: {
+          int col = explicitData[++i];
+          int row = explicitData[++i] - uselessTopBorderHeight;
+          int width = explicitData[++i];
+          int height = explicitData[++i];
+          Object fill = getUnscannedObject(explicitData[++i]);
+          placeObjectFilledRect(game, object, row, col, width, height, fill);
+          break;
+        }
+        case OBJST_RECT: {
+          int col = explicitData[++i];
+          int row = explicitData[++i] - uselessTopBorderHeight;
+          int width = explicitData[++i];
+          int height = explicitData[++i];
+          placeObjectRect(game, object, row, col, width, height);
+          break;
+        }
+      }
+    }
+  }
+}
+
+// Nothing turns into amoeba, magic wall or a fly, so a cave that starts
+// without them never gets them
+int getCaveFeatures(CaveSurvey *survey) {
+  int features = 0;
+  if (survey->objectCounts[OBJ_AMOEBA]) {
+    features |= CAVE_HAS_AMOEBA;
+  }
+  if (survey->objectCounts[OBJ_MAGIC_WALL]) {
+    features |= CAVE_HAS_MAGIC_WALL;
+  }
+  for (int object = 0; object < OBJECT_CODE_COUNT; ++object) {
+    if (survey->objectCounts[object] && (objectInfo[object].update == UPDATE_FIREFLY || objectInfo[object].update == UPDATE_BUTTERFLY)) {
+      features |= CAVE_HAS_FLIES;
+    }
+  }
+  return features;
+}
+
+// Counts the objects of a freshly decoded cave and finds where Rockford starts
+void surveyCave(CaveSurvey *survey, uint8_t map[CAVE_HEIGHT][CAVE_WIDTH]) {
+  memset(survey, 0, sizeof(*survey));
+  for (int row = 0; row < CAVE_HEIGHT; ++row) {
+    for (int col = 0; col < CAVE_WIDTH; ++col) {
+      Object object = map[row][col];
+      survey->objectCounts[object]++;
+      if (object == OBJ_PRE_ROCKFORD_1) {
+        survey->rockfordRow = row;
+        survey->rockfordCol = col;
+      }
+    }
+  }
+  survey->features = getCaveFeatures(survey);
+}
+
+void applyCaveSurvey(GameState *game, CaveSurvey *survey) {
+  game->caveFeatures = survey->features;
+  if (survey->objectCounts[OBJ_PRE_ROCKFORD_1]) {
+    game->rockfordRow = survey->rockfordRow;
+    game->rockfordCol = survey->rockfordCol;
+  }
+}
+
+DecodedCave decodedCaves[CAVE_COUNT];
+
+void decodeCaveOnce(DecodedCave *cave, int caveIndex) {
+  static GameState scratch;
+  memset(&scratch, 0, sizeof(scratch));
+  decodeCave(&scratch, caveData[caveIndex]);
+
+  memcpy(cave->map, scratch.map, sizeof(cave->map));
+  memcpy(cave->activeCells, scratch.activeCells, sizeof(cave->activeCells));
+  memcpy(cave->spaceCells, scratch.spaceCells, sizeof(cave->spaceCells));
+  memcpy(cave->roundCells, scratch.roundCells, sizeof(cave->roundCells));
+  memcpy(cave->restingCells, scratch.restingCells, sizeof(cave->restingCells));
+  memcpy(cave->amoebaCanGrowCells, scratch.amoebaCanGrowCells, sizeof(cave->amoebaCanGrowCells));
+  surveyCave(&cave->survey, cave->map);
+  cave->isDecoded = true;
+}
+
+// Caves are decoded on first use. That isn't thread safe, so programs that
+// start games on several threads call decodeAllCaves first. That also builds
+// the random fills pack caves are decoded with.
+DecodedCave *getDecodedCave(int caveIndex) {
+  assert(caveIndex >= 0 && caveIndex < CAVE_COUNT);
+  DecodedCave *cave = &decodedCaves[caveIndex];
+  if (!cave->isDecoded) {
+    decodeCaveOnce(cave, caveIndex);
+  }
+  return cave;
+}
+
+void decodeAllCaves(void) {
+  for (int caveIndex = 0; caveIndex < CAVE_COUNT; ++caveIndex) {
+    getDecodedCave(caveIndex);
+  }
+}
+
+// Same as decodeCave, but copies the cave and its cell masks from the cache
+void loadDecodedCave(GameState *game, int caveIndex) {
+  DecodedCave *cave = getDecodedCave(caveIndex);
+  game->caveInfo = getCaveInfo(caveIndex);
+  memcpy(game->map, cave->map, sizeof(game->map));
+  memcpy(game->activeCells, cave->activeCells, sizeof(game->activeCells));
+  memcpy(game->spaceCells, cave->spaceCells, sizeof(game->spaceCells));
+  memcpy(game->roundCells, cave->roundCells, sizeof(game->roundCells));
+  memcpy(game->restingCells, cave->restingCells, sizeof(game->restingCells));
+  memcpy(game->amoebaCanGrowCells, cave->amoebaCanGrowCells, sizeof(game->amoebaCanGrowCells));
+  memset(game->scannedCells, 0, sizeof(game->scannedCells));
+  game->awakeRows = ((uint64_t)1 << CAVE_HEIGHT) - 1;
+  applyCaveSurvey(game, &cave->survey);
+}
+
+// Pack caves aren't cached, there can be any number of them. A broken cave
+// is played as solid steel wall, so it costs a life instead of a crash.
+void loadPackCave(GameState *game, int caveIndex) {
+  static uint8_t brokenCave[sizeof(CaveInfo) + 7] = {
+    [sizeof(CaveInfo)] = (OBJST_FILLED_RECT << 6) | OBJ_STEEL_WALL, 0, 2, CAVE_WIDTH, CAVE_HEIGHT, OBJ_STEEL_WALL, 0xFF,
+  };
+  uint8_t *data = getPackCaveData(game->cavePack, caveIndex);
+  if (!data) {
+    data = brokenCave;
+  }
+  decodeCave(game, data);
+
+  CaveSurvey survey;
+  surveyCave(&survey, game->map);
+  applyCaveSurvey(game, &survey);
+}
+
+int getCaveCount(GameState *game) {
+  return game->cavePack ? (int)game->cavePack->caveCount : CAVE_COUNT;
+}
+
+void setCavePack(GameState *game, CavePack *pack) {
+  game->cavePack = pack;
+}
+
+//
+// Gameplay
+//
+
+typedef char soundEventsFitMask[SOUND_COUNT <= 32 ? 1 : -1];
+
+void playSoundEvent(GameState *game, SoundID soundId) {
+  game->soundEvents |= (uint32_t)1 << soundId;
+}
+
+void explodeCell(GameState *game, int row, int col, bool toDiamonds, int stage) {
+  if (getCell(game, row, col) != OBJ_STEEL_WALL) {
+    if (toDiamonds) {
+      setCell(game, row, col, stage == 0 ? OBJ_EXPLODE_TO_DIAMOND_0 : OBJ_EXPLODE_TO_DIAMOND_1);
+    } else {
+      setCell(game, row, col, stage == 0 ? OBJ_EXPLODE_TO_SPACE_0 : OBJ_EXPLODE_TO_SPACE_1);
+    }
+  }
+}
+
+void explode(GameState *game, int atRow, int atCol, int scanRow, int scanCol) {
+  bool toDiamonds = explodesToDiamonds(getCell(game, atRow, atCol));
+
+  for (int row = atRow-1; row <= atRow+1; ++row) {
+    for (int col = atCol-1; col <= atCol+1; ++col) {
+      int stage = ((row < scanRow) || (row == scanRow && col <= scanCol)) ? 1 : 0;
+      explodeCell(game, row, col, toDiamonds, stage);
+    }
+  }
+}
+
+FORCE_INLINE void updateBoulderAndDiamond(GameState *game, int row, int col, bool isFalling, bool isBoulder, int features) {
+  Object fallingObj = isBoulder ? OBJ_BOULDER_FALLING : OBJ_DIAMOND_FALLING;
+  Object stationaryObj = isBoulder ? OBJ_BOULDER_STATIONARY : OBJ_DIAMOND_STATIONARY;
+  Object fallingObjInvert = isBoulder ? OBJ_DIAMOND_FALLING : OBJ_BOULDER_FALLING;
+
+  if (getCell(game, row+1, col) == OBJ_SPACE) {
+    setScannedCell(game, row+1, col, fallingObj);
+    setCell(game, row, col, OBJ_SPACE);
+    if (!isFalling) {
+      playSoundEvent(game, isBoulder ? SND_BOULDER : SND_DIAMOND);
+    }
+  } else if ((features & CAVE_HAS_MAGIC_WALL) && isFalling && getCell(game, row+1, col) == OBJ_MAGIC_WALL) {
+    if (game->magicWallStatus == MAGIC_WALL_OFF) {
+      game->magicWallStatus = MAGIC_WALL_ON;
+    }
+    if (game->magicWallStatus == MAGIC_WALL_ON && getCell(game, row+2, col) == OBJ_SPACE) {
+      setScannedCell(game, row+2, col, fallingObjInvert);
+    }
+    setCell(game, row, col, OBJ_SPACE);
+  } else if (isObjectRound(getCell(game, row+1, col))) {
+    // Try to roll off
+    if (getCell(game, row, col-1) == OBJ_SPACE && getCell(game, row+1, col-1) == OBJ_SPACE) {
+      // Roll left
+      setScannedCell(game, row, col-1, fallingObj);
+      setCell(game, row, col, OBJ_SPACE);
+    } else if (getCell(game, row, col+1) == OBJ_SPACE && getCell(game, row+1, col+1) == OBJ_SPACE) {
+      // Roll right
+      setScannedCell(game, row, col+1, fallingObj);
+      setCell(game, row, col, OBJ_SPACE);
+    } else {
+      setScannedCell(game, row, col, stationaryObj);
+      if (isFalling) {
+        playSoundEvent(game, isBoulder ? SND_BOULDER : SND_DIAMOND);
+      }
+    }
+  } else if (isFalling && isObjectExplosive(getCell(game, row+1, col))) {
+    explode(game, row+1, col, row, col);
+  } else {
+    setScannedCell(game, row, col, stationaryObj);
+    if (isFalling) {
+      playSoundEvent(game, isBoulder ? SND_BOULDER : SND_DIAMOND);
+    }
+  }
+}
+
+bool isFailed(GameState *game) {
+  return game->turnsSinceRockfordSeenAlive >= 16 || game->isOutOfTime;
+}
+
+typedef struct {
+  int8_t dRow;
+  int8_t dCol;
+  uint8_t newDirection; // Direction
+} FlyMove;
+
+// Where a fly facing some direction moves for each way it can turn
+FlyMove flyMoves[DIRECTION_COUNT][TURNING_COUNT] = {
+  [UP]    = {[TURN_LEFT] = { 0, -1, LEFT},  [STRAIGHT_AHEAD] = {-1,  0, UP},    [TURN_RIGHT] = { 0,  1, RIGHT}},
+  [DOWN]  = {[TURN_LEFT] = { 0,  1, RIGHT}, [STRAIGHT_AHEAD] = { 1,  0, DOWN},  [TURN_RIGHT] = { 0, -1, LEFT}},
+  [LEFT]  = {[TURN_LEFT] = { 1,  0, DOWN},  [STRAIGHT_AHEAD] = { 0, -1, LEFT},  [TURN_RIGHT] = {-1,  0, UP}},
+  [RIGHT] = {[TURN_LEFT] = {-1,  0, UP},    [STRAIGHT_AHEAD] = { 0,  1, RIGHT}, [TURN_RIGHT] = { 1,  0, DOWN}},
+};
+
+// Indexed by isFirefly
+uint8_t flyObjects[2][DIRECTION_COUNT] = {
+  [false] = {[UP] = OBJ_BUTTERFLY_UP, [DOWN] = OBJ_BUTTERFLY_DOWN, [LEFT] = OBJ_BUTTERFLY_LEFT, [RIGHT] = OBJ_BUTTERFLY_RIGHT},
+  [true]  = {[UP] = OBJ_FIREFLY_UP,   [DOWN] = OBJ_FIREFLY_DOWN,   [LEFT] = OBJ_FIREFLY_LEFT,   [RIGHT] = OBJ_FIREFLY_RIGHT},
+};
+
+uint8_t flyDirections[OBJECT_CODE_COUNT] = {
+  [OBJ_FIREFLY_UP]   = UP,   [OBJ_FIREFLY_DOWN]   = DOWN, [OBJ_FIREFLY_LEFT]   = LEFT, [OBJ_FIREFLY_RIGHT]   = RIGHT,
+  [OBJ_BUTTERFLY_UP] = UP,   [OBJ_BUTTERFLY_DOWN] = DOWN, [OBJ_BUTTERFLY_LEFT] = LEFT, [OBJ_BUTTERFLY_RIGHT] = RIGHT,
+};
+
+// Fireflies try to turn left first and butterflies right, then both try
+// straight ahead. A fly that can't move turns the other way on the spot.
+void updateFly(GameState *game, int row, int col, bool isFirefly) {
+  if (checkFlyExplode(getCell(game, row-1, col)) || checkFlyExplode(getCell(game, row+1, col)) ||
+      checkFlyExplode(getCell(game, row, col-1)) || checkFlyExplode(getCell(game, row, col+1))) {
+    explode(game, row, col, row, col);
+  } else {
+    FlyMove *moves = flyMoves[flyDirections[getCell(game, row, col)]];
+    FlyMove *move = &moves[isFirefly ? TURN_LEFT : TURN_RIGHT];
+    if (getCell(game, row + move->dRow, col + move->dCol) != OBJ_SPACE) {
+      move = &moves[STRAIGHT_AHEAD];
+    }
+    if (getCell(game, row + move->dRow, col + move->dCol) == OBJ_SPACE) {
+      setScannedCell(game, row + move->dRow, col + move->dCol, flyObjects[isFirefly][move->newDirection]);
+      setCell(game, row, col, OBJ_SPACE);
+    } else {
+      move = &moves[isFirefly ? TURN_RIGHT : TURN_LEFT];
+      setScannedCell(game, row, col, flyObjects[isFirefly][move->newDirection]);
+    }
+  }
+}
+
+void addScore(GameState *game, int amount) {
+  game->score += amount;
+
+  // Check for bonus life
+  game->scoreTillBonusLife -= amount;
+  if (game->scoreTillBonusLife <= 0) {
+    game->scoreTillBonusLife += BONUS_LIFE_COST;
+    game->spaceFlashingTurnsLeft = SPACE_FLASHING_TURNS;
+    ++game->livesLeft;
+    if (game->livesLeft > MAX_LIVES) {
+      game->livesLeft = MAX_LIVES;
+    }
+  }
+}
+
+// The number the cave data at currentCaveNumber gives itself. caveInfo can't
+// be used for this: between caves it still belongs to the cave just left.
+int getCurrentCaveDataNumber(GameState *game) {
+  if (game->largeCave) {
+    return game->largeCave->caveInfo.caveNumber;
+  }
+  if (game->cavePack) {
+    uint8_t *data = getPackCaveData(game->cavePack, game->currentCaveNumber);
+    return data ? ((CaveInfo *)data)->caveNumber : 0;
+  }
+  return getCaveInfo(game->currentCaveNumber)->caveNumber;
+}
+
+// Asks the cave itself, so intermissions are found anywhere in a cave pack
+bool isIntermission(GameState *game) {
+  return getCurrentCaveDataNumber(game) >= FIRST_INTERMISSION_CAVE_NUMBER;
+}
+
+void incrementCaveNumber(GameState *game) {
+  ++game->currentCaveNumber;
+  if (game->currentCaveNumber >= getCaveCount(game)) {
+    game->currentCaveNumber = 0;
+    if (game->difficultyLevel < NUM_DIFFICULTY_LEVELS-1) {
+      ++game->difficultyLevel;
+    }
+  }
+}
+
+char getCurrentCaveLetter(GameState *game) {
+  int caveNumber = getCurrentCaveDataNumber(game);
+  if (caveNumber >= 1 && caveNumber < FIRST_INTERMISSION_CAVE_NUMBER) {
+    return (char)('A' + caveNumber - 1);
+  }
+  return ' ';
+}
+
+bool canAmoebaGrowHere(GameState *game, int row, int col) {
+  if (game->largeCave) {
+    return hasObjectProperty(getCell(game, row, col), OBJPROP_AMOEBA_CAN_GROW);
+  }
+  return (game->amoebaCanGrowCells[row] >> col) & 1;
+}
+
+// Whether the amoeba has room to grow into one of the four cells next to it
+bool canAmoebaGrowAround(GameState *game, int row, int col) {
+  if (game->largeCave) {
+    return
+      canAmoebaGrowHere(game, row-1, col) ||
+      canAmoebaGrowHere(game, row+1, col) ||
+      canAmoebaGrowHere(game, row, col-1) ||
+      canAmoebaGrowHere(game, row, col+1);
+  }
+  uint64_t cells = game->amoebaCanGrowCells[row];
+  uint64_t neighbours = game->amoebaCanGrowCells[row-1] | game->amoebaCanGrowCells[row+1] | (cells << 1) | (cells >> 1);
+  return (neighbours >> col) & 1;
+}
+
+void getRandomCellNear(GameState *game, int row, int col, int *newRow, int *newCol) {
+  *newRow = row;
+  *newCol = col;
+  switch (getRandomBelow(&game->gameplayRandom, DIRECTION_COUNT)) {
+    case UP:    (*newRow)--; break;
+    case DOWN:  (*newRow)++; break;
+    case LEFT:  (*newCol)--; break;
+    case RIGHT: (*newCol)++; break;
+  }
+}
+
+//
+// Simulation
+//
+
+// Games started with the same seed and played with the same input are identical
+void initGame(GameState *game, int caveNumber, int difficultyLevel, uint64_t seed) {
+  memset(game, 0, sizeof(*game));
+  seedRandomStream(&game->gameplayRandom, seed, RANDOM_STREAM_GAMEPLAY);
+  seedRandomStream(&game->cosmeticRandom, seed, RANDOM_STREAM_COSMETIC);
+  game->startCaveNumber = caveNumber;
+  game->startDifficultyLevel = difficultyLevel;
+  game->isGameStart = true;
+}
+
+// Only allocated chunks can hold Rockford. Large caves should have just one.
+void findLargeCaveRockford(GameState *game) {
+  LargeCave *cave = game->largeCave;
+  for (int chunkRow = 0; chunkRow < cave->chunkRows; ++chunkRow) {
+    for (int chunkCol = 0; chunkCol < cave->chunkColumns; ++chunkCol) {
+      CaveChunk *chunk = cave->chunks[chunkRow][chunkCol];
+      if (!chunk) {
+        continue;
+      }
+      for (int row = 0; row < CHUNK_SIZE; ++row) {
+        for (int col = 0; col < CHUNK_SIZE; ++col) {
+          if (chunk->map[row][col] == OBJ_PRE_ROCKFORD_1) {
+            game->rockfordRow = chunkRow*CHUNK_SIZE + row;
+            game->rockfordCol = chunkCol*CHUNK_SIZE + col;
+            if (DEV_NEAR_OUTBOX) {
+              setCell(game, game->rockfordRow-1, game->rockfordCol, OBJ_FLASHING_OUTBOX);
+            }
+            return;
+          }
+        }
+      }
+    }
+  }
+}
+
+// Plays the large cave instead of the original caves. The game restores it from
+// the original on every cave start, so the original must outlive the game and
+// stay unchanged. Call after initGame.
+void setLargeCave(GameState *game, LargeCave *cave, LargeCave *original) {
+  memset(cave, 0, sizeof(*cave));
+  game->largeCave = cave;
+  game->originalLargeCave = original;
+}
+
+void startCave(GameState *game) {
+  if (game->largeCave) {
+    restoreLargeCave(game->largeCave, game->originalLargeCave);
+    game->caveInfo = &game->largeCave->caveInfo;
+    game->caveFeatures = CAVE_ALL_FEATURES;
+  } else if (game->cavePack) {
+    loadPackCave(game, game->currentCaveNumber);
+  } else {
+    loadDecodedCave(game, game->currentCaveNumber);
+  }
+  game->loadedCaveNumber = game->currentCaveNumber;
+
+  game->isExitingCave = false;
+  game->turnsSinceRockfordSeenAlive = 0;
+  game->diamondsCollected = 0;
+  game->currentDiamondValue = game->caveInfo->initialDiamondValue;
+  game->caveTimeLeft = DEV_QUICK_OUT_OF_TIME ? 5 : game->caveInfo->caveTime[game->difficultyLevel];
+
+  game->amoebaSlowGrowthTimeLeft = game->caveInfo->magicWallMillingTime;
+  game->magicWallMillingTimeLeft = game->caveInfo->magicWallMillingTime;
+
+  game->ticksTillNextCaveSecond = TICKS_PER_CAVE_SECOND;
+  game->isOutOfTime = false;
+  game->isOutOfTimeTextShown = false;
+  game->outOfTimeTurn = 0;
+  game->rockfordTurnsTillBirth = DEV_IMMEDIATE_STARTUP ? 0 : ROCKFORD_TURNS_TILL_BIRTH;
+  game->cellCoverTurnsLeft = DEV_IMMEDIATE_STARTUP ? 1 : CELL_COVER_TURNS;
+  game->magicWallStatus = MAGIC_WALL_OFF;
+
+  game->numberOfAmoebaFoundThisTurn = 0;
+  game->totalAmoebaFoundLastTurn = 0;
+  game->amoebaSuffocatedLastTurn = false;
+  game->atLeastOneAmoebaFoundThisTurnWhichCanGrow = true;
+
+  game->rockfordIsBlinking = false;
+  game->rockfordIsTapping = false;
+  game->tileCoverTicksLeft = 0;
+  game->rockfordIsMoving = false;
+  game->rockfordIsFacingRight = true;
+
+  if (DEV_SINGLE_DIAMOND_NEEDED) {
+    game->caveInfo->diamondsNeeded[game->difficultyLevel] = 1;
+  }
+
+  for (int row = 0; row < CAVE_HEIGHT; ++row) {
+    for (int col = 0; col < CAVE_WIDTH; ++col) {
+      game->cellCover[row][col] = true;
+    }
+  }
+
+  for (int row = 0; row < PLAYFIELD_HEIGHT_IN_TILES; ++row) {
+    for (int col = 0; col < PLAYFIELD_WIDTH_IN_TILES; ++col) {
+      game->tileCover[row][col] = false;
+    }
+  }
+
+  // Find initial rockford position, small caves have it from the survey
+  if (game->largeCave) {
+    findLargeCaveRockford(game);
+    return;
+  }
+  if (DEV_NEAR_OUTBOX) {
+    setCell(game, game->rockfordRow-1, game->rockfordCol, OBJ_FLASHING_OUTBOX);
+  }
+}
+
+void updateRockford(GameState *game, GameInput *input, int row, int col) {
+  game->turnsSinceRockfordSeenAlive = 0;
+
+  int newRow = row;
+  int newCol = col;
+
+  game->rockfordIsMoving = false;
+
+  if (!game->isOutOfTime && game->tileCoverTicksLeft == 0) {
+    if (input->keys & INPUT_RIGHT) {
+      game->rockfordIsMoving = true;
+      game->rockfordIsFacingRight = true;
+      ++newCol;
+    } else if (input->keys & INPUT_LEFT) {
+      game->rockfordIsMoving = true;
+      game->rockfordIsFacingRight = false;
+      --newCol;
+    } else if (input->keys & INPUT_DOWN) {
+      game->rockfordIsMoving = true;
+      ++newRow;
+    } else if (input->keys & INPUT_UP) {
+      game->rockfordIsMoving = true;
+      --newRow;
+    }
+  }
+
+  bool actuallyMoved = false;
+
+  switch (getCell(game, newRow, newCol)) {
+    case OBJ_SPACE:
+      actuallyMoved = true;
+      playSoundEvent(game, SND_ROCKFORD_MOVE_SPACE);
+      break;
+
+    case OBJ_DIRT:
+      actuallyMoved = true;
+      playSoundEvent(game, SND_ROCKFORD_MOVE_DIRT);
+      break;
+
+    case OBJ_DIAMOND_STATIONARY:
+      //
+      // Pick up a diamond
+      //
+
+      actuallyMoved = true;
+      addScore(game, game->currentDiamondValue);
+      playSoundEvent(game, SND_DIAMOND);
+
+      // Check if all the needed diamonds for this cave were collected
+      ++game->diamondsCollected;
+      if (game->diamondsCollected == game->caveInfo->diamondsNeeded[game->difficultyLevel]) {
+        game->currentDiamondValue = game->caveInfo->extraDiamondValue;
+        game->isBorderFlashing = true;
+      }
+      break;
+
+    case OBJ_BOULDER_STATIONARY:
+      // Pushing boulders
+      if (getRandomBelow(&game->gameplayRandom, 4) == 0) {
+        if ((input->keys & INPUT_RIGHT) && getCell(game, newRow, newCol+1) == OBJ_SPACE) {
+          setScannedCell(game, newRow, newCol+1, OBJ_BOULDER_STATIONARY);
+          actuallyMoved = true;
+          playSoundEvent(game, SND_BOULDER);
+        } else if ((input->keys & INPUT_LEFT) && getCell(game, newRow, newCol-1) == OBJ_SPACE) {
+          setScannedCell(game, newRow, newCol-1, OBJ_BOULDER_STATIONARY);
+          actuallyMoved = true;
+          playSoundEvent(game, SND_BOULDER);
+        }
+      }
+      break;
+
+    case OBJ_FLASHING_OUTBOX:
+      actuallyMoved = true;
+      game->isAddingTimeToScore = true;
+      break;
+  }
+
+  if (actuallyMoved) {
+    if (input->keys & INPUT_FIRE) {
+      setCell(game, newRow, newCol, OBJ_SPACE);
+    } else {
+      setCell(game, row, col, OBJ_SPACE);
+      setScannedCell(game, newRow, newCol, OBJ_ROCKFORD);
+      game->rockfordRow = newRow;
+      game->rockfordCol = newCol;
+    }
+  }
+
+  //
+  // Update Rockford idle animation
+  //
+
+  if (game->rockfordIsMoving) {
+    game->rockfordIsBlinking = false;
+    game->rockfordIsTapping = false;
+  } else {
+    if (game->tick % 8 == 0) {
+      game->rockfordIsBlinking = getRandomBelow(&game->cosmeticRandom, 4) == 0;
+      if (getRandomBelow(&game->cosmeticRandom, 16) == 0) {
+        game->rockfordIsTapping = !game->rockfordIsTapping;
+      }
+    }
+  }
+}
+
+void updateAmoeba(GameState *game, int row, int col) {
+  ++game->numberOfAmoebaFoundThisTurn;
+  if (game->totalAmoebaFoundLastTurn >= TOO_MANY_AMOEBA) {
+    setCell(game, row, col, OBJ_BOULDER_STATIONARY);
+  } else if (game->amoebaSuffocatedLastTurn) {
+    setCell(game, row, col, OBJ_DIAMOND_STATIONARY);
+  } else {
+    if (!game->atLeastOneAmoebaFoundThisTurnWhichCanGrow) {
+      game->atLeastOneAmoebaFoundThisTurnWhichCanGrow = canAmoebaGrowAround(game, row, col);
+    }
+    int amoebaRandomFactor = game->amoebaSlowGrowthTimeLeft > 0 ? AMOEBA_FACTOR_SLOW : AMOEBA_FACTOR_FAST;
+    if (getRandomBelow(&game->gameplayRandom, amoebaRandomFactor) < 4) {
+      int newRow, newCol;
+      getRandomCellNear(game, row, col, &newRow, &newCol);
+      if (canAmoebaGrowHere(game, newRow, newCol)) {
+        setCell(game, newRow, newCol, OBJ_AMOEBA);
+      }
+    }
+  }
+  playSoundEvent(game, SND_AMOEBA);
+}
+
+// Runs the update routine objectInfo has for the object. Objects the cave
+// doesn't have are left out of the switch, see CAVE_HAS_
+FORCE_INLINE void updateCell(GameState *game, GameInput *input, int row, int col, int features) {
+  Object object = getCell(game, row, col);
+  ObjectInfo *info = &objectInfo[object];
+
+  switch (info->update) {
+    case UPDATE_NONE:
+      break;
+
+    case UPDATE_INBOX:
+      game->turnsSinceRockfordSeenAlive = 0;
+      if (game->rockfordTurnsTillBirth == 0) {
+        setCell(game, row, col, info->nextObject);
+      } else if (game->cellCoverTurnsLeft == 0) {
+        game->rockfordTurnsTillBirth--;
+      }
+      break;
+
+    case UPDATE_HATCHING:
+      game->turnsSinceRockfordSeenAlive = 0;
+      setCell(game, row, col, info->nextObject);
+      if (info->nextObject == OBJ_ROCKFORD) {
+        playSoundEvent(game, SND_ROCKFORD_BIRTH);
+      }
+      break;
+
+    case UPDATE_ROCKFORD:
+      updateRockford(game, input, row, col);
+      break;
+
+    case UPDATE_BOULDER:
+      updateBoulderAndDiamond(game, row, col, object == OBJ_BOULDER_FALLING, true, features);
+      break;
+
+    case UPDATE_DIAMOND:
+      updateBoulderAndDiamond(game, row, col, object == OBJ_DIAMOND_FALLING, false, features);
+      break;
+
+    case UPDATE_EXPLOSION:
+      setCell(game, row, col, info->nextObject);
+      break;
+
+    case UPDATE_OUTBOX:
+      if (game->diamondsCollected >= game->caveInfo->diamondsNeeded[game->difficultyLevel]) {
+        setCell(game, row, col, info->nextObject);
+      }
+      break;
+
+    case UPDATE_FIREFLY:
+    case UPDATE_BUTTERFLY:
+      if (features & CAVE_HAS_FLIES) {
+        updateFly(game, row, col, info->update == UPDATE_FIREFLY);
+      }
+      break;
+
+    case UPDATE_AMOEBA:
+      if (features & CAVE_HAS_AMOEBA) {
+        updateAmoeba(game, row, col);
+      }
+      break;
+  }
+}
+
+// Scans a large cave, skipping sleeping chunks. Chunks are visited left to
+// right within every cave row, so the order stays the same as a full scan.
+void scanLargeCave(GameState *game, GameInput *input) {
+  LargeCave *cave = game->largeCave;
+  ++cave->scanNumber;
+
+  for (int row = 0; row < cave->height; ++row) {
+    int chunkRow = row / CHUNK_SIZE;
+    // Only rows above can wake a chunk row, and those were already scanned
+    if (row % CHUNK_SIZE == 0 && !cave->awakeChunks[chunkRow]) {
+      row += CHUNK_SIZE-1;
+      continue;
+    }
+    uint64_t chunksLeft = ~(uint64_t)0;
+    for (;;) {
+      uint64_t chunks = cave->awakeChunks[chunkRow] & chunksLeft;
+      if (!chunks) {
+        break;
+      }
+      int chunkCol = findLowestSetBit(chunks);
+      chunksLeft = (~(uint64_t)0 << chunkCol) << 1;
+
+      uint64_t rowBit = (uint64_t)1 << (row % CHUNK_SIZE);
+      if (!(cave->awakeRows[chunkRow][chunkCol] & rowBit)) {
+        continue;
+      }
+
+      uint64_t cellsLeft = ~(uint64_t)0;
+      for (;;) {
+        // Re-read every time, the chunk gets copied on its first write
+        CaveChunk *chunk = cave->chunks[chunkRow][chunkCol];
+        if (!chunk) {
+          break;
+        }
+        uint64_t cells = (chunk->activeCells[row % CHUNK_SIZE] | getLargeCaveLooseCells(cave, row, chunkCol)) &
+          ~getLargeCaveScannedCells(cave, chunk, row) & cellsLeft;
+        if (!cells) {
+          break;
+        }
+        int col = findLowestSetBit(cells);
+        cellsLeft = (~(uint64_t)0 << col) << 1;
+        updateCell(game, input, row, chunkCol*CHUNK_SIZE + col, CAVE_ALL_FEATURES);
+      }
+
+      // Settled rows sleep until a change in them or in the row below
+      CaveChunk *chunk = cave->chunks[chunkRow][chunkCol];
+      if (!chunk || (!chunk->activeCells[row % CHUNK_SIZE] && !getLargeCaveLooseCells(cave, row, chunkCol))) {
+        cave->awakeRows[chunkRow][chunkCol] &= ~rowBit;
+      }
+    }
+  }
+
+  // Chunks where every row sleeps are skipped altogether
+  for (int chunkRow = 0; chunkRow < cave->chunkRows; ++chunkRow) {
+    uint64_t chunks = cave->awakeChunks[chunkRow];
+    while (chunks) {
+      int chunkCol = findLowestSetBit(chunks);
+      chunks &= chunks - 1;
+      if (!cave->awakeRows[chunkRow][chunkCol]) {
+        cave->awakeChunks[chunkRow] &= ~((uint64_t)1 << chunkCol);
+      }
+    }
+  }
+}
+
+FORCE_INLINE void scanOriginalCave(GameState *game, GameInput *input, int features) {
+  memset(game->scannedCells, 0, sizeof(game->scannedCells));
+
+  // Only active and loose cells are visited, in the same row-major order as a
+  // full scan. The row masks are re-read after every cell because updating a
+  // cell can activate or loosen cells further along the row.
+  uint64_t rowsLeft = ~(uint64_t)0;
+  for (;;) {
+    uint64_t rows = game->awakeRows & rowsLeft;
+    if (!rows) {
+      break;
+    }
+    int row = findLowestSetBit(rows);
+    rowsLeft = ~(uint64_t)0 << (row+1);
+
+    uint64_t cellsLeft = ~(uint64_t)0;
+    for (;;) {
+      uint64_t cells = (game->activeCells[row] | getLooseCells(game, row)) & ~game->scannedCells[row] & cellsLeft;
+      if (!cells) {
+        break;
+      }
+      int col = findLowestSetBit(cells);
+      cellsLeft = ~(uint64_t)0 << (col+1);
+
+      updateCell(game, input, row, col, features);
+    }
+
+    // Settled rows sleep until setCell changes them or the row below
+    if (!game->activeCells[row] && !getLooseCells(game, row)) {
+      game->awakeRows &= ~((uint64_t)1 << row);
+    }
+  }
+}
+
+#define SCAN_KERNEL(features) \
+  void scanCaveWithFeatures##features(GameState *game, GameInput *input) { scanOriginalCave(game, input, features); }
+SCAN_KERNEL(0) SCAN_KERNEL(1) SCAN_KERNEL(2) SCAN_KERNEL(3)
+SCAN_KERNEL(4) SCAN_KERNEL(5) SCAN_KERNEL(6) SCAN_KERNEL(7)
+#undef SCAN_KERNEL
+
+typedef void ScanKernel(GameState *game, GameInput *input);
+
+ScanKernel *scanKernels[CAVE_ALL_FEATURES+1] = {
+  scanCaveWithFeatures0, scanCaveWithFeatures1, scanCaveWithFeatures2, scanCaveWithFeatures3,
+  scanCaveWithFeatures4, scanCaveWithFeatures5, scanCaveWithFeatures6, scanCaveWithFeatures7,
+};
+
+void scanCave(GameState *game, GameInput *input) {
+  if (game->largeCave) {
+    scanLargeCave(game, input);
+  } else {
+    scanKernels[game->caveFeatures](game, input);
+  }
+}
+
+void moveCamera(GameState *game, int rockfordRectLeft, int rockfordRectTop) {
+  int rockfordRectRight = rockfordRectLeft + CELL_SIZE;
+  int rockfordRectBottom = rockfordRectTop + CELL_SIZE;
+
+  if (rockfordRectRight > CAMERA_START_RIGHT) {
+    game->cameraVelX = CAMERA_STEP;
+  } else if (rockfordRectLeft < CAMERA_START_LEFT) {
+    game->cameraVelX = -CAMERA_STEP;
+  }
+  if (rockfordRectBottom > CAMERA_START_BOTTOM) {
+    game->cameraVelY = CAMERA_STEP;
+  } else if (rockfordRectTop < CAMERA_START_TOP) {
+    game->cameraVelY = -CAMERA_STEP;
+  }
+
+  if (rockfordRectLeft >= CAMERA_STOP_LEFT && rockfordRectRight <= CAMERA_STOP_RIGHT) {
+    game->cameraVelX = 0;
+  }
+  if (rockfordRectTop >= CAMERA_STOP_TOP && rockfordRectBottom <= CAMERA_STOP_BOTTOM) {
+    game->cameraVelY = 0;
+  }
+
+  game->cameraX += game->cameraVelX;
+  game->cameraY += game->cameraVelY;
+
+  if (game->cameraX < CAMERA_X_MIN) {
+    game->cameraX = CAMERA_X_MIN;
+  } else if (game->cameraX > CAMERA_X_MAX) {
+    game->cameraX = CAMERA_X_MAX;
+  }
+
+  if (game->cameraY < CAMERA_Y_MIN) {
+    game->cameraY = CAMERA_Y_MIN;
+  } else if (game->cameraY > CAMERA_Y_MAX) {
+    game->cameraY = CAMERA_Y_MAX;
+  }
+}
+
+void doTurn(GameState *game, GameInput *input, int rockfordRectLeft, int rockfordRectTop) {
+  game->turn++;
+
+  game->isBorderFlashing = false;
+
+  if (game->turnsTillExitingCave == 0 && game->spaceFlashingTurnsLeft > 0) {
+    --game->spaceFlashingTurnsLeft;
+  }
+
+  if (game->magicWallStatus == MAGIC_WALL_ON) {
+    playSoundEvent(game, SND_MAGIC_WALL);
+  }
+
+  moveCamera(game, rockfordRectLeft, rockfordRectTop);
+
+  //
+  // Out of time
+  //
+
+  if (game->isOutOfTime) {
+    ++game->outOfTimeTurn;
+    if (game->isOutOfTimeTextShown) {
+      if (game->outOfTimeTurn == OUT_OF_TIME_ON_TURNS) {
+        game->outOfTimeTurn = 0;
+        game->isOutOfTimeTextShown = false;
+      }
+    } else {
+      if (game->outOfTimeTurn == OUT_OF_TIME_OFF_TURNS) {
+        game->outOfTimeTurn = 0;
+        game->isOutOfTimeTextShown = true;
+      }
+    }
+  }
+
+  //////////////////////
+
+  if (game->turnsTillGameRestart > 0) {
+    --game->turnsTillGameRestart;
+    if (game->turnsTillGameRestart == 0) {
+      game->isGameStart = true;
+    }
+  } else if (game->turnsTillExitingCave > 0) {
+    --game->turnsTillExitingCave;
+    if (game->turnsTillExitingCave == 0) {
+      game->tileCoverTicksLeft = TILE_COVER_TICKS;
+    }
+  } else if (game->isExitingCave) {
+    // Do nothing
+  } else if (game->cellCoverTurnsLeft > 0) {
+    //
+    // Update cell cover
+    //
+
+    game->cellCoverTurnsLeft--;
+    if (game->cellCoverTurnsLeft > 1) {
+      for (int row = 0; row < CAVE_HEIGHT; ++row) {
+        for (int i = 0; i < 3; ++i) {
+          game->cellCover[row][getRandomBelow(&game->cosmeticRandom, CAVE_WIDTH)] = false;
+        }
+      }
+      playSoundEvent(game, SND_UPDATE_CELL_COVER);
+    } else if (game->cellCoverTurnsLeft == 1) {
+      game->pauseTurnsLeft = COVER_PAUSE;
+    } else if (game->cellCoverTurnsLeft == 0) {
+      for (int row = 0; row < CAVE_HEIGHT; ++row) {
+        for (int col = 0; col < CAVE_WIDTH; ++col) {
+          game->cellCover[row][col] = false;
+        }
+      }
+    }
+  } else {
+    //
+    // Before cave scanning
+    //
+
+    ++game->turnsSinceRockfordSeenAlive;
+
+    /////
+
+    game->totalAmoebaFoundLastTurn = game->numberOfAmoebaFoundThisTurn;
+    game->numberOfAmoebaFoundThisTurn = 0;
+
+    game->amoebaSuffocatedLastTurn = !game->atLeastOneAmoebaFoundThisTurnWhichCanGrow;
+    game->atLeastOneAmoebaFoundThisTurnWhichCanGrow = false;
+
+    scanCave(game, input);
+
+    //
+    // Handle failure
+    //
+
+    if (game->tileCoverTicksLeft == 0 && game->rockfordTurnsTillBirth == 0 &&
+        ((isFailed(game) && (input->keys & INPUT_FIRE)) || (input->keys & INPUT_FAIL))) {
+      game->tileCoverTicksLeft = TILE_COVER_TICKS;
+      if (isIntermission(game)) {
+        incrementCaveNumber(game);
+      } else {
+        --game->livesLeft;
+      }
+    }
+  }
+}
+
+// Advances the game by one tick. The platform layer is expected to call this
+// every tickDuration seconds; headless runs can call it as fast as they like.
+void stepTick(GameState *game, GameInput *input) {
+  game->soundEvents = 0;
+
+  // Initialization on game start
+  if (game->isGameStart) {
+    game->isGameStart = false;
+
+    game->isCaveStart = true;
+    game->pauseTurnsLeft = 0;
+    game->currentCaveNumber = game->startCaveNumber;
+    game->difficultyLevel = game->startDifficultyLevel;
+    game->livesLeft = DEV_SINGLE_LIFE ? 1 : 3;
+    game->score = 0;
+    game->scoreTillBonusLife = BONUS_LIFE_COST;
+    game->spaceFlashingTurnsLeft = 0;
+  }
+
+  // Initialization on cave start
+  if (game->isCaveStart && game->pauseTurnsLeft == 0) {
+    game->isCaveStart = false;
+    startCave(game);
+  }
+
+  game->tick++;
+
+  // A key tapped between two turns still counts on the next turn. Directions
+  // are queued, so two taps within one turn move Rockford on two turns. Queued
+  // directions that are still held at the turn are dropped, held keys keep
+  // their usual priority.
+  uint8_t newKeys = input->keys & ~game->lastTickKeys;
+  game->lastTickKeys = input->keys;
+  game->pressedKeys |= newKeys & ~INPUT_DIRECTIONS;
+  for (uint8_t direction = INPUT_RIGHT; direction <= INPUT_UP; direction <<= 1) {
+    if ((newKeys & direction) && game->tappedDirectionCount < MAX_TAPPED_DIRECTIONS) {
+      game->tappedDirections[game->tappedDirectionCount++] = direction;
+    }
+  }
+  GameInput turnInput = {input->keys | game->pressedKeys};
+  if (game->tick % TICKS_PER_TURN == 0) {
+    int tapCount = 0;
+    for (int i = 0; i < game->tappedDirectionCount; i++) {
+      if (!(input->keys & game->tappedDirections[i])) {
+        game->tappedDirections[tapCount++] = game->tappedDirections[i];
+      }
+    }
+    if (tapCount > 0) {
+      turnInput.keys = (turnInput.keys & ~INPUT_DIRECTIONS) | game->tappedDirections[0];
+      tapCount--;
+      memmove(game->tappedDirections, game->tappedDirections + 1, tapCount);
+    }
+    game->tappedDirectionCount = tapCount;
+    game->pressedKeys = 0;
+  }
+
+  int rockfordRectLeft = PLAYFIELD_LEFT + game->rockfordCol*CELL_SIZE - game->cameraX;
+  int rockfordRectTop = PLAYFIELD_TOP + game->rockfordRow*CELL_SIZE - game->cameraY;
+
+  if (game->isAddingTimeToScore) {
+    if (game->caveTimeLeft > 0) {
+      --game->caveTimeLeft;
+      addScore(game, 1);
+      playSoundEvent(game, SND_ADDING_TIME_TO_SCORE);
+    } else {
+      game->isAddingTimeToScore = false;
+      game->isExitingCave = true;
+      incrementCaveNumber(game);
+      game->turnsTillExitingCave = TURNS_TILL_EXITING_CAVE;
+    }
+  } else {
+    //
+    // Update cave timer
+    //
+
+    if (game->turnsTillExitingCave == 0 && game->tileCoverTicksLeft == 0 &&
+        game->rockfordTurnsTillBirth == 0 && !game->isOutOfTime) {
+      --game->ticksTillNextCaveSecond;
+      if (game->ticksTillNextCaveSecond == 0) {
+        game->ticksTillNextCaveSecond = TICKS_PER_CAVE_SECOND;
+        if (game->caveTimeLeft > 0) {
+          --game->caveTimeLeft;
+
+          if (game->amoebaSlowGrowthTimeLeft > 0) {
+            --game->amoebaSlowGrowthTimeLeft;
+          }
+
+          if (game->magicWallStatus == MAGIC_WALL_ON) {
+            --game->magicWallMillingTimeLeft;
+            if (game->magicWallMillingTimeLeft == 0) {
+              game->magicWallStatus = MAGIC_WALL_EXPIRED;
+            }
+          }
+        } else {
+          game->isOutOfTime = true;
+          game->isOutOfTimeTextShown = true;
+        }
+      }
+    }
+
+    //
+    // Turn-based update logic
+    //
+
+    if (game->tick % TICKS_PER_TURN == 0) {
+      if (game->pauseTurnsLeft > 0) {
+        game->pauseTurnsLeft--;
+      } else {
+        doTurn(game, &turnInput, rockfordRectLeft, rockfordRectTop);
+      }
+    }
+
+    //
+    // Update tile cover
+    //
+
+    if (game->tileCoverTicksLeft > 0) {
+      --game->tileCoverTicksLeft;
+
+      if (game->tileCoverTicksLeft == 0) {
+        if (game->livesLeft == 0) {
+          for (int row = 0; row < PLAYFIELD_HEIGHT_IN_TILES; ++row) {
+            for (int col = 0; col < PLAYFIELD_WIDTH_IN_TILES; ++col) {
+              game->tileCover[row][col] = true;
+            }
+          }
+          game->turnsTillGameRestart = TURNS_TILL_GAME_RESTART;
+        } else {
+          game->pauseTurnsLeft = COVER_PAUSE;
+          game->isCaveStart = true;
+        }
+      } else {
+        for (int i = 0; i < 7; ++i) {
+          int row = getRandomBelow(&game->cosmeticRandom, PLAYFIELD_HEIGHT_IN_TILES);
+          int col = getRandomBelow(&game->cosmeticRandom, PLAYFIELD_WIDTH_IN_TILES);
+          game->tileCover[row][col] = true;
+        }
+        playSoundEvent(game, SND_UPDATE_TILE_COVER);
+      }
+    }
+  }
+}
+
+// Advances the game up to and including the next turn boundary.
+void stepTurn(GameState *game, GameInput *input) {
+  do {
+    stepTick(game, input);
+  } while (game->tick % TICKS_PER_TURN != 0);
+}
@@ -0,0 +1,413 @@
+// Developer options
+#define DEV_IMMEDIATE_STARTUP 0
+#define DEV_NEAR_OUTBOX 0
+#define DEV_SINGLE_DIAMOND_NEEDED 0
+#define DEV_CHEAP_BONUS_LIFE 0
+#define DEV_QUICK_OUT_OF_TIME 0
+#define DEV_SINGLE_LIFE 0
+
+// Gameplay constants
+#define START_CAVE CAVE_A
+#define TICKS_PER_TURN 5
+#define ROCKFORD_TURNS_TILL_BIRTH 12
+#define CELL_COVER_TURNS 40
+#define TILE_COVER_TICKS (32*TICKS_PER_TURN)
+#define BONUS_LIFE_COST (DEV_CHEAP_BONUS_LIFE ? 5 : 500)
+#define SPACE_FLASHING_TURNS 10
+#define MAX_LIVES 9
+#define COVER_PAUSE 2
+#define TICKS_PER_CAVE_SECOND (7*TICKS_PER_TURN)
+#define OUT_OF_TIME_ON_TURNS 25
+#define OUT_OF_TIME_OFF_TURNS 42
+#define TURNS_TILL_GAME_RESTART 10
+#define TURNS_TILL_EXITING_CAVE 12
+
+#define TOO_MANY_AMOEBA 200
+#define AMOEBA_FACTOR_SLOW 127
+#define AMOEBA_FACTOR_FAST 15
+
+// Cave map consists of cells, each cell contains 4 (2x2) tiles
+#define TILE_SIZE 8
+#define CELL_SIZE (TILE_SIZE*2)
+
+#define BORDER_SIZE CELL_SIZE
+#define STATUS_BAR_HEIGHT CELL_SIZE
+
+// Viewport is the whole screen area except the border
+#define VIEWPORT_WIDTH 256
+#define VIEWPORT_HEIGHT 192
+#define VIEWPORT_LEFT BORDER_SIZE
+#define VIEWPORT_TOP BORDER_SIZE
+#define VIEWPORT_RIGHT (VIEWPORT_LEFT + VIEWPORT_WIDTH - 1)
+#define VIEWPORT_BOTTOM (VIEWPORT_TOP + VIEWPORT_HEIGHT - 1)
+
+// Playfield is the whole viewport except the status bar
+#define PLAYFIELD_WIDTH VIEWPORT_WIDTH
+#define PLAYFIELD_HEIGHT (VIEWPORT_HEIGHT - STATUS_BAR_HEIGHT)
+#define PLAYFIELD_LEFT VIEWPORT_LEFT
+#define PLAYFIELD_TOP (VIEWPORT_TOP + STATUS_BAR_HEIGHT)
+#define PLAYFIELD_RIGHT (PLAYFIELD_LEFT + PLAYFIELD_WIDTH - 1)
+#define PLAYFIELD_BOTTOM (PLAYFIELD_TOP + PLAYFIELD_HEIGHT - 1)
+
+#define PLAYFIELD_HEIGHT_IN_TILES (PLAYFIELD_HEIGHT/TILE_SIZE)
+#define PLAYFIELD_WIDTH_IN_TILES (PLAYFIELD_WIDTH/TILE_SIZE)
+
+#define CAMERA_START_LEFT (PLAYFIELD_LEFT + 6*TILE_SIZE)
+#define CAMERA_STOP_LEFT (PLAYFIELD_LEFT + 14*TILE_SIZE)
+#define CAMERA_START_TOP (PLAYFIELD_TOP + 4*TILE_SIZE)
+#define CAMERA_STOP_TOP (PLAYFIELD_TOP + 9*TILE_SIZE)
+#define CAMERA_START_RIGHT (PLAYFIELD_RIGHT - 6*TILE_SIZE + 1)
+#define CAMERA_STOP_RIGHT (PLAYFIELD_RIGHT - 13*TILE_SIZE + 1)
+#define CAMERA_START_BOTTOM (PLAYFIELD_BOTTOM - 4*TILE_SIZE + 1)
+#define CAMERA_STOP_BOTTOM (PLAYFIELD_BOTTOM - 9*TILE_SIZE + 1)
+
+#define CAMERA_X_MIN 0
+#define CAMERA_Y_MIN 0
+#define CAMERA_X_MAX (CAVE_WIDTH*CELL_SIZE - PLAYFIELD_WIDTH)
+#define CAMERA_Y_MAX (CAVE_HEIGHT*CELL_SIZE - PLAYFIELD_HEIGHT)
+
+#define CAMERA_STEP TILE_SIZE
+
+// Objects a cave can have or not. The cave scan is compiled separately for
+// every combination and picked when the cave starts.
+#define CAVE_HAS_AMOEBA     (1 << 0)
+#define CAVE_HAS_MAGIC_WALL (1 << 1)
+#define CAVE_HAS_FLIES      (1 << 2)
+#define CAVE_ALL_FEATURES   (CAVE_HAS_AMOEBA | CAVE_HAS_MAGIC_WALL | CAVE_HAS_FLIES)
+
+#define RANDOM_STREAM_GAMEPLAY 0
+#define RANDOM_STREAM_COSMETIC 1
+
+// Object properties
+#define OBJPROP_ACTIVE (1 << 0)                // changes on its own when the cave is scanned
+#define OBJPROP_RESTING (1 << 1)               // boulder or diamond at rest
+#define OBJPROP_ROUND (1 << 2)                 // things roll off it
+#define OBJPROP_EXPLOSIVE (1 << 3)             // explodes when something falls on it
+#define OBJPROP_EXPLODES_TO_DIAMONDS (1 << 4)
+#define OBJPROP_KILLS_FLY (1 << 5)             // fireflies and butterflies explode next to it
+#define OBJPROP_AMOEBA_CAN_GROW (1 << 6)       // amoeba can grow into it
+#define OBJPROP_SCANNED (1 << 7)               // scanned variant of another object
+
+// What the cave scan does with an object, see updateCell
+typedef enum {
+  UPDATE_NONE,
+  UPDATE_INBOX,     // waits for the birth delay, then starts hatching
+  UPDATE_HATCHING,
+  UPDATE_ROCKFORD,
+  UPDATE_BOULDER,
+  UPDATE_DIAMOND,
+  UPDATE_EXPLOSION,
+  UPDATE_OUTBOX,    // opens once enough diamonds are collected
+  UPDATE_FIREFLY,
+  UPDATE_BUTTERFLY,
+  UPDATE_AMOEBA,
+} ObjectUpdate;
+
+// All objects with their codes and properties. Both the Object enum and the
+// objectInfo table are generated from this list, so an object can't be added
+// without a table entry. The unscanned column is the object itself, or for a
+// scanned variant the object it is a variant of. The update column picks the
+// routine the cave scan runs for the object, and the last column is what the
+// object turns into when that routine advances it (inbox, explosion stages,
+// outbox) or the object itself.
+#define OBJECT_LIST(X) \
+  X(OBJ_SPACE,                      0x00, OBJPROP_AMOEBA_CAN_GROW,                                           OBJ_SPACE,                      UPDATE_NONE,      OBJ_SPACE) \
+  X(OBJ_DIRT,                       0x01, OBJPROP_AMOEBA_CAN_GROW,                                           OBJ_DIRT,                       UPDATE_NONE,      OBJ_DIRT) \
+  X(OBJ_BRICK_WALL,                 0x02, OBJPROP_ROUND,                                                     OBJ_BRICK_WALL,                 UPDATE_NONE,      OBJ_BRICK_WALL) \
+  X(OBJ_MAGIC_WALL,                 0x03, 0,                                                                 OBJ_MAGIC_WALL,                 UPDATE_NONE,      OBJ_MAGIC_WALL) \
+  X(OBJ_PRE_OUTBOX,                 0x04, OBJPROP_ACTIVE,                                                    OBJ_PRE_OUTBOX,                 UPDATE_OUTBOX,    OBJ_FLASHING_OUTBOX) \
+  X(OBJ_FLASHING_OUTBOX,            0x05, 0,                                                                 OBJ_FLASHING_OUTBOX,            UPDATE_NONE,      OBJ_FLASHING_OUTBOX) \
+  X(OBJ_STEEL_WALL,                 0x07, 0,                                                                 OBJ_STEEL_WALL,                 UPDATE_NONE,      OBJ_STEEL_WALL) \
+  X(OBJ_FIREFLY_LEFT,               0x08, OBJPROP_ACTIVE | OBJPROP_EXPLOSIVE,                                OBJ_FIREFLY_LEFT,               UPDATE_FIREFLY,   OBJ_FIREFLY_LEFT) \
+  X(OBJ_FIREFLY_UP,                 0x09, OBJPROP_ACTIVE | OBJPROP_EXPLOSIVE,                                OBJ_FIREFLY_UP,                 UPDATE_FIREFLY,   OBJ_FIREFLY_UP) \
+  X(OBJ_FIREFLY_RIGHT,              0x0A, OBJPROP_ACTIVE | OBJPROP_EXPLOSIVE,                                OBJ_FIREFLY_RIGHT,              UPDATE_FIREFLY,   OBJ_FIREFLY_RIGHT) \
+  X(OBJ_FIREFLY_DOWN,               0x0B, OBJPROP_ACTIVE | OBJPROP_EXPLOSIVE,                                OBJ_FIREFLY_DOWN,               UPDATE_FIREFLY,   OBJ_FIREFLY_DOWN) \
+  X(OBJ_FIREFLY_LEFT_SCANNED,       0x0C, OBJPROP_SCANNED,                                                   OBJ_FIREFLY_LEFT,               UPDATE_NONE,      OBJ_FIREFLY_LEFT_SCANNED) \
+  X(OBJ_FIREFLY_UP_SCANNED,         0x0D, OBJPROP_SCANNED,                                                   OBJ_FIREFLY_UP,                 UPDATE_NONE,      OBJ_FIREFLY_UP_SCANNED) \
+  X(OBJ_FIREFLY_RIGHT_SCANNED,      0x0E, OBJPROP_SCANNED,                                                   OBJ_FIREFLY_RIGHT,              UPDATE_NONE,      OBJ_FIREFLY_RIGHT_SCANNED) \
+  X(OBJ_FIREFLY_DOWN_SCANNED,       0x0F, OBJPROP_SCANNED,                                                   OBJ_FIREFLY_DOWN,               UPDATE_NONE,      OBJ_FIREFLY_DOWN_SCANNED) \
+  X(OBJ_BOULDER_STATIONARY,         0x10, OBJPROP_ROUND | OBJPROP_RESTING,                                   OBJ_BOULDER_STATIONARY,         UPDATE_BOULDER,   OBJ_BOULDER_STATIONARY) \
+  X(OBJ_BOULDER_STATIONARY_SCANNED, 0x11, OBJPROP_SCANNED,                                                   OBJ_BOULDER_STATIONARY,         UPDATE_NONE,      OBJ_BOULDER_STATIONARY_SCANNED) \
+  X(OBJ_BOULDER_FALLING,            0x12, OBJPROP_ACTIVE,                                                    OBJ_BOULDER_FALLING,            UPDATE_BOULDER,   OBJ_BOULDER_FALLING) \
+  X(OBJ_BOULDER_FALLING_SCANNED,    0x13, OBJPROP_SCANNED,                                                   OBJ_BOULDER_FALLING,            UPDATE_NONE,      OBJ_BOULDER_FALLING_SCANNED) \
+  X(OBJ_DIAMOND_STATIONARY,         0x14, OBJPROP_ROUND | OBJPROP_RESTING,                                   OBJ_DIAMOND_STATIONARY,         UPDATE_DIAMOND,   OBJ_DIAMOND_STATIONARY) \
+  X(OBJ_DIAMOND_STATIONARY_SCANNED, 0x15, OBJPROP_SCANNED,                                                   OBJ_DIAMOND_STATIONARY,         UPDATE_NONE,      OBJ_DIAMOND_STATIONARY_SCANNED) \
+  X(OBJ_DIAMOND_FALLING,            0x16, OBJPROP_ACTIVE,                                                    OBJ_DIAMOND_FALLING,            UPDATE_DIAMOND,   OBJ_DIAMOND_FALLING) \
+  X(OBJ_DIAMOND_FALLING_SCANNED,    0x17, OBJPROP_SCANNED,                                                   OBJ_DIAMOND_FALLING,            UPDATE_NONE,      OBJ_DIAMOND_FALLING_SCANNED) \
+  X(OBJ_EXPLODE_TO_SPACE_0,         0x1B, OBJPROP_ACTIVE,                                                    OBJ_EXPLODE_TO_SPACE_0,         UPDATE_EXPLOSION, OBJ_EXPLODE_TO_SPACE_1) \
+  X(OBJ_EXPLODE_TO_SPACE_1,         0x1C, OBJPROP_ACTIVE,                                                    OBJ_EXPLODE_TO_SPACE_1,         UPDATE_EXPLOSION, OBJ_EXPLODE_TO_SPACE_2) \
+  X(OBJ_EXPLODE_TO_SPACE_2,         0x1D, OBJPROP_ACTIVE,                                                    OBJ_EXPLODE_TO_SPACE_2,         UPDATE_EXPLOSION, OBJ_EXPLODE_TO_SPACE_3) \
+  X(OBJ_EXPLODE_TO_SPACE_3,         0x1E, OBJPROP_ACTIVE,                                                    OBJ_EXPLODE_TO_SPACE_3,         UPDATE_EXPLOSION, OBJ_EXPLODE_TO_SPACE_4) \
+  X(OBJ_EXPLODE_TO_SPACE_4,         0x1F, OBJPROP_ACTIVE,                                                    OBJ_EXPLODE_TO_SPACE_4,         UPDATE_EXPLOSION, OBJ_SPACE) \
+  X(OBJ_EXPLODE_TO_DIAMOND_0,       0x20, OBJPROP_ACTIVE,                                                    OBJ_EXPLODE_TO_DIAMOND_0,       UPDATE_EXPLOSION, OBJ_EXPLODE_TO_DIAMOND_1) \
+  X(OBJ_EXPLODE_TO_DIAMOND_1,       0x21, OBJPROP_ACTIVE,                                                    OBJ_EXPLODE_TO_DIAMOND_1,       UPDATE_EXPLOSION, OBJ_EXPLODE_TO_DIAMOND_2) \
+  X(OBJ_EXPLODE_TO_DIAMOND_2,       0x22, OBJPROP_ACTIVE,                                                    OBJ_EXPLODE_TO_DIAMOND_2,       UPDATE_EXPLOSION, OBJ_EXPLODE_TO_DIAMOND_3) \
+  X(OBJ_EXPLODE_TO_DIAMOND_3,       0x23, OBJPROP_ACTIVE,                                                    OBJ_EXPLODE_TO_DIAMOND_3,       UPDATE_EXPLOSION, OBJ_EXPLODE_TO_DIAMOND_4) \
+  X(OBJ_EXPLODE_TO_DIAMOND_4,       0x24, OBJPROP_ACTIVE,                                                    OBJ_EXPLODE_TO_DIAMOND_4,       UPDATE_EXPLOSION, OBJ_DIAMOND_STATIONARY) \
+  X(OBJ_PRE_ROCKFORD_1,             0x25, OBJPROP_ACTIVE,                                                    OBJ_PRE_ROCKFORD_1,             UPDATE_INBOX,     OBJ_PRE_ROCKFORD_2) \
+  X(OBJ_PRE_ROCKFORD_2,             0x26, OBJPROP_ACTIVE,                                                    OBJ_PRE_ROCKFORD_2,             UPDATE_HATCHING,  OBJ_PRE_ROCKFORD_3) \
+  X(OBJ_PRE_ROCKFORD_3,             0x27, OBJPROP_ACTIVE,                                                    OBJ_PRE_ROCKFORD_3,             UPDATE_HATCHING,  OBJ_PRE_ROCKFORD_4) \
+  X(OBJ_PRE_ROCKFORD_4,             0x28, OBJPROP_ACTIVE,                                                    OBJ_PRE_ROCKFORD_4,             UPDATE_HATCHING,  OBJ_ROCKFORD) \
+  X(OBJ_BUTTERFLY_DOWN,             0x30, OBJPROP_ACTIVE | OBJPROP_EXPLOSIVE | OBJPROP_EXPLODES_TO_DIAMONDS, OBJ_BUTTERFLY_DOWN,             UPDATE_BUTTERFLY, OBJ_BUTTERFLY_DOWN) \
+  X(OBJ_BUTTERFLY_LEFT,             0x31, OBJPROP_ACTIVE | OBJPROP_EXPLOSIVE | OBJPROP_EXPLODES_TO_DIAMONDS, OBJ_BUTTERFLY_LEFT,             UPDATE_BUTTERFLY, OBJ_BUTTERFLY_LEFT) \
+  X(OBJ_BUTTERFLY_UP,               0x32, OBJPROP_ACTIVE | OBJPROP_EXPLOSIVE | OBJPROP_EXPLODES_TO_DIAMONDS, OBJ_BUTTERFLY_UP,               UPDATE_BUTTERFLY, OBJ_BUTTERFLY_UP) \
+  X(OBJ_BUTTERFLY_RIGHT,            0x33, OBJPROP_ACTIVE | OBJPROP_EXPLOSIVE | OBJPROP_EXPLODES_TO_DIAMONDS, OBJ_BUTTERFLY_RIGHT,            UPDATE_BUTTERFLY, OBJ_BUTTERFLY_RIGHT) \
+  X(OBJ_BUTTERFLY_DOWN_SCANNED,     0x34, OBJPROP_SCANNED,                                                   OBJ_BUTTERFLY_DOWN,             UPDATE_NONE,      OBJ_BUTTERFLY_DOWN_SCANNED) \
+  X(OBJ_BUTTERFLY_LEFT_SCANNED,     0x35, OBJPROP_SCANNED,                                                   OBJ_BUTTERFLY_LEFT,             UPDATE_NONE,      OBJ_BUTTERFLY_LEFT_SCANNED) \
+  X(OBJ_BUTTERFLY_UP_SCANNED,       0x36, OBJPROP_SCANNED,                                                   OBJ_BUTTERFLY_UP,               UPDATE_NONE,      OBJ_BUTTERFLY_UP_SCANNED) \
+  X(OBJ_BUTTERFLY_RIGHT_SCANNED,    0x37, OBJPROP_SCANNED,                                                   OBJ_BUTTERFLY_RIGHT,            UPDATE_NONE,      OBJ_BUTTERFLY_RIGHT_SCANNED) \
+  X(OBJ_ROCKFORD,                   0x38, OBJPROP_ACTIVE | OBJPROP_EXPLOSIVE | OBJPROP_KILLS_FLY,            OBJ_ROCKFORD,                   UPDATE_ROCKFORD,  OBJ_ROCKFORD) \
+  X(OBJ_ROCKFORD_SCANNED,           0x39, OBJPROP_SCANNED,                                                   OBJ_ROCKFORD,                   UPDATE_NONE,      OBJ_ROCKFORD_SCANNED) \
+  X(OBJ_AMOEBA,                     0x3A, OBJPROP_ACTIVE | OBJPROP_KILLS_FLY,                                OBJ_AMOEBA,                     UPDATE_AMOEBA,    OBJ_AMOEBA) \
+  X(OBJ_AMOEBA_SCANNED,             0x3B, OBJPROP_SCANNED,                                                   OBJ_AMOEBA,                     UPDATE_NONE,      OBJ_AMOEBA_SCANNED)
+
+typedef enum {
+#define X(name, code, properties, unscannedObject, update, nextObject) name = code,
+  OBJECT_LIST(X)
+#undef X
+} Object; // *_SCANNED objects only come from cave data, see getUnscannedObject
+
+#define OBJECT_CODE_COUNT 64
+
+typedef struct {
+  uint8_t properties;
+  uint8_t unscannedObject;
+  uint8_t update; // ObjectUpdate
+  uint8_t nextObject;
+} ObjectInfo;
+
+typedef enum {
+  OBJST_SINGLE,
+  OBJST_LINE,
+  OBJST_FILLED_RECT,
+  OBJST_RECT,
+} ObjectStructure;
+
+#define CAVE_HEIGHT 22
+#define CAVE_WIDTH 40
+#define NUM_DIFFICULTY_LEVELS 5
+#define NUM_RANDOM_OBJECTS 4
+
+typedef struct {
+  uint8_t caveNumber;
+  uint8_t magicWallMillingTime; // also amoebaSlowGrowthTime
+  uint8_t initialDiamondValue;
+  uint8_t extraDiamondValue;
+  uint8_t randomiserSeed[NUM_DIFFICULTY_LEVELS];
+  uint8_t diamondsNeeded[NUM_DIFFICULTY_LEVELS];
+  uint8_t caveTime[NUM_DIFFICULTY_LEVELS];
+  uint8_t backgroundColor1;
+  uint8_t backgroundColor2;
+  uint8_t foregroundColor;
+  uint8_t unused[2];
+  uint8_t randomObject[NUM_RANDOM_OBJECTS];
+  uint8_t objectProbability[NUM_RANDOM_OBJECTS];
+} CaveInfo;
+
+// Caves A to P are numbered from 1, the intermissions follow them
+#define FIRST_INTERMISSION_CAVE_NUMBER 17
+
+typedef enum {
+  CAVE_A, CAVE_B, CAVE_C, CAVE_D, INTERMISSION_1,
+  CAVE_E, CAVE_F, CAVE_G, CAVE_H, INTERMISSION_2,
+  CAVE_I, CAVE_J, CAVE_K, CAVE_L, INTERMISSION_3,
+  CAVE_M, CAVE_N, CAVE_O, CAVE_P, INTERMISSION_4,
+  CAVE_COUNT,
+} CaveName;
+
+typedef enum {UP, DOWN, LEFT, RIGHT, DIRECTION_COUNT} Direction;
+typedef enum {TURN_LEFT, STRAIGHT_AHEAD, TURN_RIGHT, TURNING_COUNT} Turning;
+typedef enum {MAGIC_WALL_OFF, MAGIC_WALL_ON, MAGIC_WALL_EXPIRED} MagicWallStatus;
+
+// Large caves are stored in square chunks, one 64-bit mask word per chunk row
+#define CHUNK_SIZE 64
+#define MAX_LARGE_CAVE_SIZE 4096
+#define MAX_CHUNKS_PER_SIDE (MAX_LARGE_CAVE_SIZE / CHUNK_SIZE)
+
+typedef struct {
+  uint8_t map[CHUNK_SIZE][CHUNK_SIZE];
+  uint64_t activeCells[CHUNK_SIZE];
+  uint64_t spaceCells[CHUNK_SIZE];
+  uint64_t roundCells[CHUNK_SIZE];
+  uint64_t restingCells[CHUNK_SIZE];
+  uint64_t scannedCells[CHUNK_SIZE];
+  int scanNumber; // scannedCells are left over from an earlier scan unless this matches the cave's
+} CaveChunk;
+
+// A cave of up to MAX_LARGE_CAVE_SIZE cells per side. Chunks that were never
+// written to aren't allocated and read as fillObject. Rows of a chunk sleep
+// while nothing in them can move, and the cave scan skips sleeping rows and
+// chunks where every row sleeps.
+typedef struct {
+  int width;
+  int height;
+  int chunkColumns;
+  int chunkRows;
+  Object fillObject;
+  CaveInfo caveInfo;
+  int scanNumber;
+  CaveChunk *chunks[MAX_CHUNKS_PER_SIDE][MAX_CHUNKS_PER_SIDE];
+  uint64_t ownedChunks[MAX_CHUNKS_PER_SIDE]; // the rest are shared with the original cave
+  uint64_t awakeChunks[MAX_CHUNKS_PER_SIDE];
+  uint64_t awakeRows[MAX_CHUNKS_PER_SIDE][MAX_CHUNKS_PER_SIDE]; // one bit per row of every chunk
+} LargeCave;
+
+typedef enum {
+  SND_ROCKFORD_MOVE_SPACE,
+  SND_ROCKFORD_MOVE_DIRT,
+  SND_DIAMOND,
+  SND_BOULDER,
+  SND_ADDING_TIME_TO_SCORE,
+  SND_UPDATE_CELL_COVER,
+  SND_UPDATE_TILE_COVER,
+  SND_ROCKFORD_BIRTH,
+  SND_AMOEBA,
+  SND_MAGIC_WALL,
+  SOUND_COUNT,
+} SoundID;
+
+#define INPUT_RIGHT (1 << 0)
+#define INPUT_LEFT  (1 << 1)
+#define INPUT_DOWN  (1 << 2)
+#define INPUT_UP    (1 << 3)
+#define INPUT_FIRE  (1 << 4)
+#define INPUT_FAIL  (1 << 5)
+#define INPUT_DIRECTIONS (INPUT_RIGHT | INPUT_LEFT | INPUT_DOWN | INPUT_UP)
+
+#define MAX_TAPPED_DIRECTIONS 4
+
+// Keys held during one tick, filled in by the platform layer
+typedef struct {
+  uint8_t keys;
+} GameInput;
+
+// What a cave has at cave start, see surveyCave
+typedef struct {
+  uint16_t objectCounts[OBJECT_CODE_COUNT];
+  int rockfordRow;
+  int rockfordCol;
+  int features; // CAVE_HAS_
+} CaveSurvey;
+
+// A cave as it is at cave start, with the cell masks setCell would build.
+// The layout doesn't depend on the difficulty level, so there is one per cave.
+typedef struct {
+  uint8_t map[CAVE_HEIGHT][CAVE_WIDTH];
+  uint64_t activeCells[CAVE_HEIGHT];
+  uint64_t spaceCells[CAVE_HEIGHT];
+  uint64_t roundCells[CAVE_HEIGHT];
+  uint64_t restingCells[CAVE_HEIGHT];
+  uint64_t amoebaCanGrowCells[CAVE_HEIGHT];
+  CaveSurvey survey;
+  bool isDecoded;
+} DecodedCave;
+
+// Everything the simulation reads and writes. The game doesn't use any global
+// state apart from the read-only decoded caves (see getDecodedCave), so any
+// number of games can be simulated side by side.
+typedef struct {
+  uint8_t map[CAVE_HEIGHT][CAVE_WIDTH];
+
+  // Cell masks, kept in sync with the map by setCell
+  uint64_t activeCells[CAVE_HEIGHT];  // objects that the cave scan has to visit
+  uint64_t spaceCells[CAVE_HEIGHT];
+  uint64_t roundCells[CAVE_HEIGHT];
+  uint64_t restingCells[CAVE_HEIGHT]; // boulders and diamonds at rest
+  uint64_t amoebaCanGrowCells[CAVE_HEIGHT];
+  uint64_t awakeRows; // rows that can have active or loose cells, one bit per row
+  uint64_t scannedCells[CAVE_HEIGHT]; // objects already updated this turn
+
+  // Set by setLargeCave. The map and cell masks above are unused then.
+  LargeCave *largeCave;         // the cave being played
+  LargeCave *originalLargeCave; // restored on every cave start
+
+  // Set by setCavePack. Cave numbers are pack cave indices then.
+  CavePack *cavePack;
+
+  CaveInfo *caveInfo;
+  bool cellCover[CAVE_HEIGHT][CAVE_WIDTH];
+  bool tileCover[PLAYFIELD_HEIGHT_IN_TILES][PLAYFIELD_WIDTH_IN_TILES];
+
+  int turn;
+  int tick;
+
+  // Gameplay randomness is kept apart from animations, so that cosmetic
+  // changes don't change how a game plays out
+  RandomStream gameplayRandom;
+  RandomStream cosmeticRandom;
+
+  int startCaveNumber;
+  int startDifficultyLevel;
+
+  bool isGameStart;
+  int turnsTillGameRestart;
+  int turnsTillExitingCave;
+  bool isAddingTimeToScore;
+  bool isBorderFlashing;
+
+  uint8_t lastTickKeys;
+  uint8_t pressedKeys; // keys other than directions pressed since the last turn, applied on the next one
+  uint8_t tappedDirections[MAX_TAPPED_DIRECTIONS]; // oldest first, one is applied per turn
+  int tappedDirectionCount;
+
+  int cameraX;
+  int cameraY;
+  int cameraVelX;
+  int cameraVelY;
+
+  //
+  // These variables are initialized when game starts
+  //
+
+  bool isCaveStart;
+  int pauseTurnsLeft;
+  int currentCaveNumber;
+  int difficultyLevel;
+  int livesLeft;
+  int score;
+  int scoreTillBonusLife;
+  int spaceFlashingTurnsLeft;
+
+  //
+  // These variables are initialized when cave starts
+  //
+
+  int loadedCaveNumber;
+  int caveFeatures;
+  bool isExitingCave;
+  int caveTimeLeft;
+  int ticksTillNextCaveSecond;
+  bool isOutOfTime;
+  bool isOutOfTimeTextShown;
+  int outOfTimeTurn;
+  int diamondsCollected;
+  int currentDiamondValue;
+  int rockfordTurnsTillBirth;
+  int cellCoverTurnsLeft;
+  int tileCoverTicksLeft;
+  int turnsSinceRockfordSeenAlive;
+
+  int rockfordCol;
+  int rockfordRow;
+  bool rockfordIsBlinking;
+  bool rockfordIsTapping;
+  bool rockfordIsMoving;
+  bool rockfordIsFacingRight;
+
+  MagicWallStatus magicWallStatus;
+  int amoebaSlowGrowthTimeLeft;
+  int magicWallMillingTimeLeft;
+
+  int numberOfAmoebaFoundThisTurn;
+  int totalAmoebaFoundLastTurn;
+  bool amoebaSuffocatedLastTurn;
+  bool atLeastOneAmoebaFoundThisTurnWhichCanGrow;
+
+  //
+  // Output of the last tick
+  //
+
+  // One bit per SoundID. A sound that is triggered many times during a tick
+  // (e.g. by every amoeba cell) is played once.
+  uint32_t soundEvents;
+} GameState;
@@ -0,0 +1,223 @@
+//
+// Parameter space
+//
+
+// Every candidate is a point in a space of 2^32 random fills: 8 bits of
+// randomiser seed, then 3 bits of object and 3 bits of probability for each
+// of the random objects
+uint8_t generatorObjects[8] = {
+  OBJ_SPACE, OBJ_BOULDER_STATIONARY, OBJ_DIAMOND_STATIONARY, OBJ_BRICK_WALL,
+  OBJ_FIREFLY_LEFT, OBJ_BUTTERFLY_DOWN, OBJ_AMOEBA, OBJ_MAGIC_WALL,
+};
+uint8_t generatorProbabilities[8] = {0x04, 0x08, 0x0C, 0x14, 0x1E, 0x28, 0x3C, 0x50};
+
+typedef char generatorSpaceFitsCandidatePoint[8 + NUM_RANDOM_OBJECTS*6 <= 32 ? 1 : -1];
+
+// Candidates are spread over the whole space with an odd multiplier, so the
+// first n candidates are n different points whatever n is
+void getCandidateCaveInfo(uint64_t candidateIndex, CaveInfo *caveInfo) {
+  uint32_t point = (uint32_t)(candidateIndex * 0x9E3779B97F4A7C15ull);
+  caveInfo->randomiserSeed[0] = point & 0xFF;
+  point >>= 8;
+  for (int i = 0; i < NUM_RANDOM_OBJECTS; i++) {
+    caveInfo->randomObject[i] = generatorObjects[point & 7];
+    point >>= 3;
+    caveInfo->objectProbability[i] = generatorProbabilities[point & 7];
+    point >>= 3;
+  }
+}
+
+//
+// Metrics
+//
+
+double getReachableDiamondsMetric(CandidateCave *candidate) {
+  return candidate->analysis.reachableDiamonds;
+}
+
+double getBoulderDensityMetric(CandidateCave *candidate) {
+  int innerCells = (CAVE_HEIGHT-2) * (CAVE_WIDTH-2);
+  return (double)candidate->survey->objectCounts[OBJ_BOULDER_STATIONARY] / innerCells;
+}
+
+double getOpenAreaMetric(CandidateCave *candidate) {
+  return candidate->analysis.reachableCellCount;
+}
+
+// Many diamonds behind many boulders, with no flies or amoeba to spoil it
+double getDiggingMetric(CandidateCave *candidate) {
+  CaveSurvey *survey = candidate->survey;
+  if (survey->features & (CAVE_HAS_FLIES | CAVE_HAS_AMOEBA)) {
+    return 0;
+  }
+  int boulders = survey->objectCounts[OBJ_BOULDER_STATIONARY];
+  int diamonds = survey->objectCounts[OBJ_DIAMOND_STATIONARY];
+  return (double)boulders * (diamonds - candidate->analysis.reachableDiamonds);
+}
+
+CaveMetric caveMetrics[] = {
+  {"diamonds", getReachableDiamondsMetric, "diamonds reachable from the start"},
+  {"boulders", getBoulderDensityMetric, "boulders per cell"},
+  {"open", getOpenAreaMetric, "cells reachable from the start"},
+  {"digging", getDiggingMetric, "diamonds that need digging out, times boulders"},
+};
+
+CaveMetric *findCaveMetric(char *name) {
+  for (int i = 0; i < ARRAY_LENGTH(caveMetrics); i++) {
+    if (strcmp(caveMetrics[i].name, name) == 0) {
+      return &caveMetrics[i];
+    }
+  }
+  return 0;
+}
+
+//
+// Search
+//
+
+// Ties go to the earlier candidate, so the result doesn't depend on how the
+// jobs were spread over threads
+bool isBetterWinner(GeneratorWinner *a, GeneratorWinner *b) {
+  if (a->score != b->score) {
+    return a->score > b->score;
+  }
+  return a->candidateIndex < b->candidateIndex;
+}
+
+uint64_t getMapHash(uint8_t map[CAVE_HEIGHT][CAVE_WIDTH]) {
+  uint64_t hash = 14695981039346656037ull;
+  for (int row = 0; row < CAVE_HEIGHT; row++) {
+    for (int col = 0; col < CAVE_WIDTH; col++) {
+      hash = (hash ^ map[row][col]) * 1099511628211ull;
+    }
+  }
+  return hash;
+}
+
+// Keeps winners sorted, best first, and at most one winner per map: the
+// best candidate that decodes to it
+void addGeneratorWinner(GeneratorWinner *winners, int *winnerCount, int maxWinners, GeneratorWinner *winner) {
+  int position = *winnerCount;
+  while (position > 0 && isBetterWinner(winner, &winners[position-1])) {
+    position--;
+  }
+  if (position >= maxWinners) {
+    return;
+  }
+  for (int i = 0; i < *winnerCount; i++) {
+    if (winners[i].mapHash == winner->mapHash) {
+      if (i < position) {
+        return;
+      }
+      // The new winner takes the place of the worse one with the same map
+      memmove(&winners[i], &winners[i+1], (*winnerCount - i - 1) * sizeof(GeneratorWinner));
+      --*winnerCount;
+      break;
+    }
+  }
+  int moved = (*winnerCount < maxWinners ? *winnerCount : maxWinners-1) - position;
+  memmove(&winners[position+1], &winners[position], moved * sizeof(GeneratorWinner));
+  winners[position] = *winner;
+  if (*winnerCount < maxWinners) {
+    ++*winnerCount;
+  }
+}
+
+int getMaxDiamondsNeeded(CaveInfo *caveInfo) {
+  int diamondsNeeded = 0;
+  for (int i = 0; i < NUM_DIFFICULTY_LEVELS; i++) {
+    if (caveInfo->diamondsNeeded[i] > diamondsNeeded) {
+      diamondsNeeded = caveInfo->diamondsNeeded[i];
+    }
+  }
+  return diamondsNeeded;
+}
+
+void runGeneratorJob(void *context, int jobIndex, int workerIndex) {
+  Generator *generator = context;
+  GeneratorWinner *winners = generator->workerWinners + (size_t)workerIndex * generator->maxWinners;
+  int winnerCount = generator->workerWinnerCounts[workerIndex];
+  uint64_t acceptedCount = 0;
+
+  uint8_t cave[MAX_GENERATOR_CAVE_SIZE];
+  memcpy(cave, generator->templateCave, generator->templateSize);
+  CaveInfo *caveInfo = (CaveInfo *)cave;
+  int diamondsNeeded = getMaxDiamondsNeeded(caveInfo);
+
+  GameState game;
+  memset(&game, 0, sizeof(game));
+
+  uint64_t first = (uint64_t)jobIndex * GENERATOR_CANDIDATES_PER_JOB;
+  uint64_t end = first + GENERATOR_CANDIDATES_PER_JOB;
+  if (end > generator->candidateCount) {
+    end = generator->candidateCount;
+  }
+  for (uint64_t candidateIndex = first; candidateIndex < end; candidateIndex++) {
+    getCandidateCaveInfo(candidateIndex, caveInfo);
+    decodeCave(&game, cave);
+
+    CaveSurvey survey;
+    surveyCave(&survey, game.map);
+    CandidateCave candidate = {&game, &survey};
+    analyzeCave(&candidate.analysis, game.map, &survey);
+
+    // Caves that can't be finished without luck aren't candidates
+    if (!candidate.analysis.isOutboxReachable || candidate.analysis.reachableDiamonds < diamondsNeeded) {
+      continue;
+    }
+    acceptedCount++;
+
+    GeneratorWinner winner;
+    winner.candidateIndex = candidateIndex;
+    winner.mapHash = getMapHash(game.map);
+    winner.score = generator->metric->function(&candidate);
+    memcpy(winner.caveInfo, caveInfo, sizeof(CaveInfo));
+    addGeneratorWinner(winners, &winnerCount, generator->maxWinners, &winner);
+  }
+
+  generator->workerWinnerCounts[workerIndex] = winnerCount;
+  generator->workerAcceptedCounts[workerIndex] += acceptedCount;
+}
+
+// Returns the number of winners written to winners, best first
+int runGenerator(Generator *generator, GeneratorWinner *winners, int threadCount) {
+  assert(generator->templateSize <= MAX_GENERATOR_CAVE_SIZE);
+  assert(generator->maxWinners > 0 && generator->maxWinners <= MAX_GENERATOR_WINNERS);
+
+  // Builds the random fills before any thread needs them
+  decodeAllCaves();
+
+  uint64_t jobCount = (generator->candidateCount + GENERATOR_CANDIDATES_PER_JOB-1) / GENERATOR_CANDIDATES_PER_JOB;
+
+  // Winners are kept per worker rather than per job, so memory depends on the
+  // thread count and not on the number of candidates
+  generator->workerCount = getBatchWorkerCount(threadCount);
+  generator->workerWinners = malloc((size_t)generator->workerCount * generator->maxWinners * sizeof(GeneratorWinner));
+  assert(generator->workerWinners);
+  memset(generator->workerWinnerCounts, 0, sizeof(generator->workerWinnerCounts));
+  memset(generator->workerAcceptedCounts, 0, sizeof(generator->workerAcceptedCounts));
+
+  runBatch(runGeneratorJob, generator, (int)jobCount, generator->workerCount);
+
+  int winnerCount = 0;
+  for (int worker = 0; worker < generator->workerCount; worker++) {
+    GeneratorWinner *workerWinners = generator->workerWinners + (size_t)worker * generator->maxWinners;
+    for (int i = 0; i < generator->workerWinnerCounts[worker]; i++) {
+      addGeneratorWinner(winners, &winnerCount, generator->maxWinners, &workerWinners[i]);
+    }
+  }
+  return winnerCount;
+}
+
+uint64_t getGeneratorAcceptedCount(Generator *generator) {
+  uint64_t acceptedCount = 0;
+  for (int worker = 0; worker < generator->workerCount; worker++) {
+    acceptedCount += generator->workerAcceptedCounts[worker];
+  }
+  return acceptedCount;
+}
+
+void freeGenerator(Generator *generator) {
+  free(generator->workerWinners);
+  generator->workerWinners = 0;
+}
@@ -0,0 +1,43 @@
+// Cave generator. Takes the explicit objects of a template cave and searches
+// random fills for it: randomiser seed, random objects and their
+// probabilities. Candidates are decoded like any other cave, scored with one
+// of the cave metrics and the best ones are kept, one per decoded map.
+
+#define MAX_GENERATOR_WINNERS 256
+#define GENERATOR_CANDIDATES_PER_JOB 4096
+#define MAX_GENERATOR_CAVE_SIZE 1024
+
+// What a metric gets to look at
+typedef struct {
+  GameState *game;
+  CaveSurvey *survey;
+  CaveAnalysis analysis;
+} CandidateCave;
+
+// Higher is better
+typedef double CaveMetricFunction(CandidateCave *candidate);
+
+typedef struct {
+  char *name;
+  CaveMetricFunction *function;
+  char *description;
+} CaveMetric;
+
+typedef struct {
+  uint64_t candidateIndex;
+  uint64_t mapHash; // many candidates decode to the same map, only one of them is kept
+  double score;
+  uint8_t caveInfo[sizeof(CaveInfo)];
+} GeneratorWinner;
+
+typedef struct {
+  uint8_t *templateCave;
+  size_t templateSize;
+  CaveMetric *metric;
+  uint64_t candidateCount;
+  int maxWinners;
+  int workerCount;
+  GeneratorWinner *workerWinners; // maxWinners per batch worker, merged when all jobs are done
+  int workerWinnerCounts[MAX_BATCH_THREADS];
+  uint64_t workerAcceptedCounts[MAX_BATCH_THREADS]; // candidates that passed the filter
+} Generator;
@@ -0,0 +1,31 @@
+// SplitMix64 finalizer
+uint64_t hashRandom(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+// Streams with the same seed and different stream IDs are independent
+void seedRandomStream(RandomStream *stream, uint64_t seed, uint64_t streamId) {
+  stream->key = hashRandom(seed ^ hashRandom(streamId + 1));
+  stream->counter = 0;
+}
+
+uint32_t getRandom(RandomStream *stream) {
+  uint64_t counter = stream->counter++;
+  return (uint32_t)(hashRandom(stream->key ^ (counter * 0x9E3779B97F4A7C15ull)) >> 32);
+}
+
+// Returns a number in [0, count)
+int getRandomBelow(RandomStream *stream, int count) {
+  return (int)(((uint64_t)getRandom(stream) * (uint32_t)count) >> 32);
+}
+
+// Returns a number in [0, 1]
+float getRandomFloat(RandomStream *stream) {
+  return (float)(getRandom(stream) >> 8) / (float)((1 << 24) - 1);
+}
+
+void skipRandom(RandomStream *stream, uint64_t count) {
+  stream->counter += count;
+}
@@ -0,0 +1,7 @@
+// Counter-based random number generator. The n-th number of a stream is a hash
+// of the stream key and n, so a stream can be jumped ahead by moving the
+// counter, and every game instance can own its streams without sharing state.
+typedef struct {
+  uint64_t key;
+  uint64_t counter;
+} RandomStream;
@@ -0,0 +1,591 @@
+//
+// Headless simulation. Runs the game without a window, audio or frame pacing
+// and reports how many turns per second the simulation can do.
+//
+// Usage: simulate [cave letter] [difficulty level] [turns] [seed]
+//        simulate batch [games per cave] [turns] [threads]
+//        simulate large [cave size] [caves per side] [turns] [seed]
+//        simulate makepack [file] [cave count]
+//        simulate pack [file] [first cave] [turns] [seed]
+//        simulate generate [template cave letter] [metric] [candidates] [winners] [threads] [pack file]
+//        simulate analyze [pack file or -] [threads]
+//
+// The batch mode plays every cave on every difficulty level the given number
+// of times, spread over all cores. The large mode builds a square cave of dirt
+// with a grid of the original caves in its top left corner and plays it. The
+// makepack mode writes the original caves, repeated up to the cave count, into
+// a cave pack file, and the pack mode plays the caves of a pack starting from
+// the given index. The generate mode searches random fills for the explicit
+// objects of a template cave, keeps the ones that can be finished, scores them
+// with a metric from generator.c and can write the winners into a cave pack.
+// The analyze mode checks every cave of a pack, or the original caves for -,
+// writes a JSON line per cave and exits with 2 if some cave provably can't be
+// finished.
+//
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#define ARRAY_LENGTH(array) (sizeof(array)/sizeof(*array))
+
+#include "random.h"
+#include "cave_pack.h"
+#include "game.h"
+#include "random.c"
+#include "data_caves.h"
+#include "cave_pack.c"
+#include "game.c"
+#include "batch.h"
+#include "batch.c"
+#include "analyzer.h"
+#include "analyzer.c"
+#include "generator.h"
+#include "generator.c"
+
+double getSeconds() {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+uint32_t nextBotRandom(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+// Presses random keys, holding each direction for a few turns
+void updateBotInput(GameInput *input, uint32_t *botState) {
+  if (nextBotRandom(botState) % 4 == 0) {
+    input->keys &= ~(INPUT_RIGHT | INPUT_LEFT | INPUT_DOWN | INPUT_UP);
+    switch (nextBotRandom(botState) % 5) {
+      case 0: input->keys |= INPUT_RIGHT; break;
+      case 1: input->keys |= INPUT_LEFT;  break;
+      case 2: input->keys |= INPUT_DOWN;  break;
+      case 3: input->keys |= INPUT_UP;    break;
+    }
+  }
+  if (nextBotRandom(botState) % 16 == 0) {
+    input->keys |= INPUT_FIRE;
+  } else {
+    input->keys &= ~INPUT_FIRE;
+  }
+}
+
+uint32_t getGameChecksum(GameState *game) {
+  uint32_t hash = 2166136261u;
+  for (int row = 0; row < CAVE_HEIGHT; ++row) {
+    for (int col = 0; col < CAVE_WIDTH; ++col) {
+      hash = (hash ^ game->map[row][col]) * 16777619u;
+    }
+  }
+  hash = (hash ^ (uint32_t)game->score) * 16777619u;
+  hash = (hash ^ (uint32_t)game->currentCaveNumber) * 16777619u;
+  return hash;
+}
+
+typedef struct {
+  int caveNumber;
+  int difficultyLevel;
+  uint32_t seed;
+  int turns;
+  int score;
+  uint32_t checksum;
+} BatchGame;
+
+void runBatchGame(void *context, int jobIndex, int workerIndex) {
+  BatchGame *batchGame = (BatchGame *)context + jobIndex;
+  uint32_t botState = batchGame->seed ? batchGame->seed : 1;
+
+  GameState game;
+  initGame(&game, batchGame->caveNumber, batchGame->difficultyLevel, batchGame->seed);
+
+  GameInput input = {0};
+  for (int i = 0; i < batchGame->turns; ++i) {
+    updateBotInput(&input, &botState);
+    stepTurn(&game, &input);
+  }
+
+  batchGame->score = game.score;
+  batchGame->checksum = getGameChecksum(&game);
+}
+
+int runBatchMode(int argc, char **argv) {
+  int gamesPerCave = 10;
+  int turns = 10000;
+  int threadCount = getCoreCount();
+
+  if (argc > 2) {
+    gamesPerCave = atoi(argv[2]);
+  }
+  if (argc > 3) {
+    turns = atoi(argv[3]);
+  }
+  if (argc > 4) {
+    threadCount = atoi(argv[4]);
+    if (threadCount < 1 || threadCount > MAX_BATCH_THREADS) {
+      fprintf(stderr, "Threads must be from 1 to %d\n", MAX_BATCH_THREADS);
+      return 1;
+    }
+  }
+
+  int gameCount = CAVE_COUNT * NUM_DIFFICULTY_LEVELS * gamesPerCave;
+  if (gameCount <= 0) {
+    fprintf(stderr, "Games per cave must be positive\n");
+    return 1;
+  }
+  BatchGame *games = malloc(gameCount * sizeof(BatchGame));
+  assert(games);
+  for (int i = 0; i < gameCount; ++i) {
+    games[i].caveNumber = i % CAVE_COUNT;
+    games[i].difficultyLevel = (i / CAVE_COUNT) % NUM_DIFFICULTY_LEVELS;
+    games[i].seed = (uint32_t)i + 1;
+    games[i].turns = turns;
+  }
+
+  // Decoding on first use isn't thread safe
+  decodeAllCaves();
+
+  double startTime = getSeconds();
+  runBatch(runBatchGame, games, gameCount, threadCount);
+  double elapsed = getSeconds() - startTime;
+
+  // Combined so that it doesn't depend on the order the games finished in
+  uint32_t checksum = 0;
+  for (int i = 0; i < gameCount; ++i) {
+    checksum += games[i].checksum * (2 * (uint32_t)i + 1);
+  }
+  double totalTurns = (double)gameCount * turns;
+
+  printf("games: %d\n", gameCount);
+  printf("threads: %d\n", threadCount);
+  printf("turns: %.0f\n", totalTurns);
+  printf("seconds: %.3f\n", elapsed);
+  printf("turns per second: %.0f\n", elapsed > 0 ? totalTurns / elapsed : 0.0);
+  printf("checksum: %08X\n", checksum);
+
+  free(games);
+  return 0;
+}
+
+// Stamps the original caves in a grid, only the first one keeps its Rockford
+void buildLargeCave(LargeCave *cave, int size, int cavesPerSide) {
+  initLargeCave(cave, size, size, OBJ_DIRT);
+
+  for (int i = 0; i < cavesPerSide*cavesPerSide; ++i) {
+    int top = 1 + (i / cavesPerSide)*CAVE_HEIGHT;
+    int left = 1 + (i % cavesPerSide)*CAVE_WIDTH;
+    int caveNumber = i % CAVE_COUNT;
+    DecodedCave *decoded = getDecodedCave(caveNumber);
+    if (i == 0) {
+      cave->caveInfo = *getCaveInfo(caveNumber);
+    }
+    for (int row = 0; row < CAVE_HEIGHT; ++row) {
+      for (int col = 0; col < CAVE_WIDTH; ++col) {
+        Object object = decoded->map[row][col];
+        if (i > 0 && object == OBJ_PRE_ROCKFORD_1) {
+          object = OBJ_SPACE;
+        }
+        setLargeCaveCell(cave, top + row, left + col, object);
+      }
+    }
+  }
+
+  for (int i = 0; i < size; ++i) {
+    setLargeCaveCell(cave, 0, i, OBJ_STEEL_WALL);
+    setLargeCaveCell(cave, size-1, i, OBJ_STEEL_WALL);
+    setLargeCaveCell(cave, i, 0, OBJ_STEEL_WALL);
+    setLargeCaveCell(cave, i, size-1, OBJ_STEEL_WALL);
+  }
+}
+
+int countChunks(uint64_t *chunkMasks, int chunkRows) {
+  int count = 0;
+  for (int chunkRow = 0; chunkRow < chunkRows; ++chunkRow) {
+    for (uint64_t chunks = chunkMasks[chunkRow]; chunks; chunks &= chunks - 1) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+int runLargeMode(int argc, char **argv) {
+  int size = MAX_LARGE_CAVE_SIZE;
+  int cavesPerSide = 4;
+  int turns = 10000;
+  uint32_t seed = 1;
+
+  if (argc > 2) {
+    size = atoi(argv[2]);
+    if (size < 3 || size > MAX_LARGE_CAVE_SIZE) {
+      fprintf(stderr, "Cave size must be from 3 to %d\n", MAX_LARGE_CAVE_SIZE);
+      return 1;
+    }
+  }
+  if (argc > 3) {
+    cavesPerSide = atoi(argv[3]);
+  }
+  if (argc > 4) {
+    turns = atoi(argv[4]);
+  }
+  if (argc > 5) {
+    seed = (uint32_t)strtoul(argv[5], 0, 10);
+  }
+  if (cavesPerSide < 1 || 2 + cavesPerSide*CAVE_WIDTH > size || 2 + cavesPerSide*CAVE_HEIGHT > size) {
+    fprintf(stderr, "The caves don't fit into the large cave\n");
+    return 1;
+  }
+
+  static LargeCave original;
+  static LargeCave cave;
+  buildLargeCave(&original, size, cavesPerSide);
+
+  uint32_t botState = seed ? seed : 1;
+
+  GameState game;
+  initGame(&game, START_CAVE, 0, seed);
+  setLargeCave(&game, &cave, &original);
+
+  GameInput input = {0};
+
+  double startTime = getSeconds();
+  for (int i = 0; i < turns; ++i) {
+    updateBotInput(&input, &botState);
+    stepTurn(&game, &input);
+  }
+  double elapsed = getSeconds() - startTime;
+
+  printf("cave size: %d\n", size);
+  printf("chunks: %d\n", cave.chunkRows * cave.chunkColumns);
+  printf("allocated chunks: %d\n", countChunks(original.ownedChunks, original.chunkRows) + countChunks(cave.ownedChunks, cave.chunkRows));
+  printf("awake chunks: %d\n", countChunks(cave.awakeChunks, cave.chunkRows));
+  printf("turns: %d\n", turns);
+  printf("seconds: %.3f\n", elapsed);
+  printf("turns per second: %.0f\n", elapsed > 0 ? turns / elapsed : 0.0);
+  printf("score: %d\n", game.score);
+
+  freeLargeCave(&cave);
+  freeLargeCave(&original);
+  return 0;
+}
+
+// Writes the original caves over and over, so packs of any size can be made
+int runMakePackMode(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: simulate makepack [file] [cave count]\n");
+    return 1;
+  }
+  char *path = argv[2];
+  int caveCount = CAVE_COUNT;
+  if (argc > 3) {
+    caveCount = atoi(argv[3]);
+    if (caveCount <= 0) {
+      fprintf(stderr, "Cave count must be positive\n");
+      return 1;
+    }
+  }
+
+  uint8_t **caves = malloc(caveCount * sizeof(uint8_t *));
+  assert(caves);
+  for (int i = 0; i < caveCount; ++i) {
+    caves[i] = caveData[i % CAVE_COUNT];
+  }
+  bool isWritten = writeCavePack(path, caves, caveCount);
+  free(caves);
+
+  if (!isWritten) {
+    fprintf(stderr, "Couldn't write %s\n", path);
+    return 1;
+  }
+  printf("caves: %d\n", caveCount);
+  return 0;
+}
+
+int runPackMode(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: simulate pack [file] [first cave] [turns] [seed]\n");
+    return 1;
+  }
+  char *path = argv[2];
+  int firstCave = 0;
+  int turns = 100000;
+  uint32_t seed = 1;
+
+  double openStartTime = getSeconds();
+  static CavePack pack;
+  if (!openCavePack(&pack, path)) {
+    fprintf(stderr, "Couldn't open cave pack %s\n", path);
+    return 1;
+  }
+  double openElapsed = getSeconds() - openStartTime;
+
+  if (argc > 3) {
+    firstCave = atoi(argv[3]);
+    if (firstCave < 0 || (uint32_t)firstCave >= pack.caveCount) {
+      fprintf(stderr, "First cave must be from 0 to %u\n", pack.caveCount - 1);
+      closeCavePack(&pack);
+      return 1;
+    }
+  }
+  if (argc > 4) {
+    turns = atoi(argv[4]);
+  }
+  if (argc > 5) {
+    seed = (uint32_t)strtoul(argv[5], 0, 10);
+  }
+
+  uint32_t botState = seed ? seed : 1;
+
+  GameState game;
+  initGame(&game, firstCave, 0, seed);
+  setCavePack(&game, &pack);
+
+  GameInput input = {0};
+
+  double startTime = getSeconds();
+  for (int i = 0; i < turns; ++i) {
+    updateBotInput(&input, &botState);
+    stepTurn(&game, &input);
+  }
+  double elapsed = getSeconds() - startTime;
+
+  printf("caves: %u\n", pack.caveCount);
+  printf("open seconds: %.6f\n", openElapsed);
+  printf("turns: %d\n", turns);
+  printf("seconds: %.3f\n", elapsed);
+  printf("turns per second: %.0f\n", elapsed > 0 ? turns / elapsed : 0.0);
+  printf("score: %d\n", game.score);
+  printf("checksum: %08X\n", getGameChecksum(&game));
+
+  closeCavePack(&pack);
+  return 0;
+}
+
+int runGenerateMode(int argc, char **argv) {
+  int templateCave = START_CAVE;
+  CaveMetric *metric = &caveMetrics[0];
+  uint64_t candidateCount = 1000000;
+  int winnerCount = 10;
+  int threadCount = getCoreCount();
+  char *packPath = 0;
+
+  if (argc > 2) {
+    char letter = argv[2][0];
+    if (letter < 'A' || letter > 'T') {
+      fprintf(stderr, "Cave must be a letter from A to T\n");
+      return 1;
+    }
+    templateCave = letter - 'A';
+  }
+  if (argc > 3) {
+    metric = findCaveMetric(argv[3]);
+    if (!metric) {
+      fprintf(stderr, "Metric must be one of:\n");
+      for (int i = 0; i < ARRAY_LENGTH(caveMetrics); i++) {
+        fprintf(stderr, "  %-10s %s\n", caveMetrics[i].name, caveMetrics[i].description);
+      }
+      return 1;
+    }
+  }
+  if (argc > 4) {
+    candidateCount = strtoull(argv[4], 0, 10);
+    if (candidateCount == 0 || candidateCount > ((uint64_t)1 << 32)) {
+      fprintf(stderr, "Candidates must be from 1 to 2^32\n");
+      return 1;
+    }
+  }
+  if (argc > 5) {
+    winnerCount = atoi(argv[5]);
+    if (winnerCount < 1 || winnerCount > MAX_GENERATOR_WINNERS) {
+      fprintf(stderr, "Winners must be from 1 to %d\n", MAX_GENERATOR_WINNERS);
+      return 1;
+    }
+  }
+  if (argc > 6) {
+    threadCount = atoi(argv[6]);
+    if (threadCount < 1 || threadCount > MAX_BATCH_THREADS) {
+      fprintf(stderr, "Threads must be from 1 to %d\n", MAX_BATCH_THREADS);
+      return 1;
+    }
+  }
+  if (argc > 7) {
+    packPath = argv[7];
+  }
+
+  Generator generator = {0};
+  generator.templateCave = caveData[templateCave];
+  generator.templateSize = checkCaveData(caveData[templateCave], SIZE_MAX);
+  generator.metric = metric;
+  generator.candidateCount = candidateCount;
+  generator.maxWinners = winnerCount;
+
+  static GeneratorWinner winners[MAX_GENERATOR_WINNERS];
+  double startTime = getSeconds();
+  winnerCount = runGenerator(&generator, winners, threadCount);
+  double elapsed = getSeconds() - startTime;
+
+  printf("template: %c\n", 'A' + templateCave);
+  printf("metric: %s\n", metric->name);
+  printf("threads: %d\n", threadCount);
+  printf("candidates: %llu\n", (unsigned long long)candidateCount);
+  printf("accepted: %llu\n", (unsigned long long)getGeneratorAcceptedCount(&generator));
+  printf("seconds: %.3f\n", elapsed);
+  printf("candidates per second: %.0f\n", elapsed > 0 ? candidateCount / elapsed : 0.0);
+  for (int i = 0; i < winnerCount; i++) {
+    CaveInfo *caveInfo = (CaveInfo *)winners[i].caveInfo;
+    printf("winner %d: candidate %llu score %g seed %02X objects", i + 1,
+           (unsigned long long)winners[i].candidateIndex, winners[i].score, caveInfo->randomiserSeed[0]);
+    for (int j = 0; j < NUM_RANDOM_OBJECTS; j++) {
+      printf(" %02X/%02X", caveInfo->randomObject[j], caveInfo->objectProbability[j]);
+    }
+    printf("\n");
+  }
+
+  int exitCode = 0;
+  if (packPath && winnerCount > 0) {
+    // Winners keep the explicit objects of the template
+    uint8_t *caveBytes = malloc((size_t)winnerCount * generator.templateSize);
+    uint8_t **caves = malloc(winnerCount * sizeof(uint8_t *));
+    assert(caveBytes && caves);
+    for (int i = 0; i < winnerCount; i++) {
+      caves[i] = caveBytes + (size_t)i * generator.templateSize;
+      memcpy(caves[i], generator.templateCave, generator.templateSize);
+      memcpy(caves[i], winners[i].caveInfo, sizeof(CaveInfo));
+    }
+    if (!writeCavePack(packPath, caves, winnerCount)) {
+      fprintf(stderr, "Couldn't write %s\n", packPath);
+      exitCode = 1;
+    }
+    free(caves);
+    free(caveBytes);
+  }
+
+  freeGenerator(&generator);
+  return exitCode;
+}
+
+// The report goes to stdout, the summary to stderr
+int runAnalyzeMode(int argc, char **argv) {
+  static CavePack pack;
+  Analyzer analyzer = {0};
+  analyzer.caveCount = CAVE_COUNT;
+  int threadCount = getCoreCount();
+
+  if (argc > 2 && strcmp(argv[2], "-") != 0) {
+    if (!openCavePack(&pack, argv[2])) {
+      fprintf(stderr, "Couldn't open cave pack %s\n", argv[2]);
+      return 1;
+    }
+    analyzer.pack = &pack;
+    analyzer.caveCount = (int)pack.caveCount;
+  }
+  if (argc > 3) {
+    threadCount = atoi(argv[3]);
+    if (threadCount < 1 || threadCount > MAX_BATCH_THREADS) {
+      fprintf(stderr, "Threads must be from 1 to %d\n", MAX_BATCH_THREADS);
+      return 1;
+    }
+  }
+
+  analyzer.reports = malloc(analyzer.caveCount * sizeof(CaveReport));
+  assert(analyzer.reports);
+
+  double startTime = getSeconds();
+  runAnalyzer(&analyzer, threadCount);
+  double elapsed = getSeconds() - startTime;
+
+  int badCaveCount = 0;
+  for (int i = 0; i < analyzer.caveCount; i++) {
+    writeCaveReport(stdout, &analyzer.reports[i], i);
+    badCaveCount += isCaveReportBad(&analyzer.reports[i]);
+  }
+
+  fprintf(stderr, "caves: %d\n", analyzer.caveCount);
+  fprintf(stderr, "bad caves: %d\n", badCaveCount);
+  fprintf(stderr, "seconds: %.3f\n", elapsed);
+  fprintf(stderr, "caves per second: %.0f\n", elapsed > 0 ? analyzer.caveCount / elapsed : 0.0);
+
+  free(analyzer.reports);
+  if (analyzer.pack) {
+    closeCavePack(&pack);
+  }
+  return badCaveCount > 0 ? 2 : 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "batch") == 0) {
+    return runBatchMode(argc, argv);
+  }
+  if (argc > 1 && strcmp(argv[1], "large") == 0) {
+    return runLargeMode(argc, argv);
+  }
+  if (argc > 1 && strcmp(argv[1], "makepack") == 0) {
+    return runMakePackMode(argc, argv);
+  }
+  if (argc > 1 && strcmp(argv[1], "pack") == 0) {
+    return runPackMode(argc, argv);
+  }
+  if (argc > 1 && strcmp(argv[1], "generate") == 0) {
+    return runGenerateMode(argc, argv);
+  }
+  if (argc > 1 && strcmp(argv[1], "analyze") == 0) {
+    return runAnalyzeMode(argc, argv);
+  }
+
+  int caveNumber = START_CAVE;
+  int difficultyLevel = 0;
+  int turns = 100000;
+  uint32_t seed = 1;
+
+  if (argc > 1) {
+    char letter = argv[1][0];
+    if (letter < 'A' || letter > 'T') {
+      fprintf(stderr, "Cave must be a letter from A to T\n");
+      return 1;
+    }
+    caveNumber = letter - 'A';
+  }
+  if (argc > 2) {
+    difficultyLevel = atoi(argv[2]) - 1;
+    if (difficultyLevel < 0 || difficultyLevel >= NUM_DIFFICULTY_LEVELS) {
+      fprintf(stderr, "Difficulty level must be from 1 to %d\n", NUM_DIFFICULTY_LEVELS);
+      return 1;
+    }
+  }
+  if (argc > 3) {
+    turns = atoi(argv[3]);
+  }
+  if (argc > 4) {
+    seed = (uint32_t)strtoul(argv[4], 0, 10);
+  }
+
+  uint32_t botState = seed ? seed : 1;
+
+  GameState game;
+  initGame(&game, caveNumber, difficultyLevel, seed);
+
+  GameInput input = {0};
+
+  double startTime = getSeconds();
+  for (int i = 0; i < turns; ++i) {
+    updateBotInput(&input, &botState);
+    stepTurn(&game, &input);
+  }
+  double elapsed = getSeconds() - startTime;
+
+  printf("turns: %d\n", turns);
+  printf("seconds: %.3f\n", elapsed);
+  printf("turns per second: %.0f\n", elapsed > 0 ? turns / elapsed : 0.0);
+  printf("score: %d\n", game.score);
+  printf("checksum: %08X\n", getGameChecksum(&game));
+
+  return 0;
+}
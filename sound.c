@@ -56,13 +56,14 @@ static void initializeSoundSystem(SoundSystem *sys, float bufferDurationSec, flo
   sys->initialAddingTimeToScoreSoundFrequency = 200.0f;
   sys->addingTimeToScoreSoundFrequency = sys->initialAddingTimeToScoreSoundFrequency;
   sys->addingTimeToScoreSoundFrequencyStep = 5.0f;
+  seedRandomStream(&sys->random, 0, 0);
 
   audioClient->lpVtbl->Start(audioClient);
 }
 
-static void fillNoiseBuffer(Sound *sound) {
+static void fillNoiseBuffer(SoundSystem *sys, Sound *sound) {
   for (int i = 0; i < ARRAY_LENGTH(sound->noise); ++i) {
-    sound->noise[i] = 2.0f*((float)rand()/(float)RAND_MAX) - 1.0f;
+    sound->noise[i] = 2.0f*getRandomFloat(&sys->random) - 1.0f;
   }
 }
 
@@ -153,8 +154,8 @@ static void playSound(SoundSystem *sys, SoundID soundId) {
         assert(!"Unknown sound ID");
     }
 
-    toneFrequency = baseFrequency + freqVariance*(rand()/(float)RAND_MAX) - freqVariance;
-    soundDurationSec = sys->tickDuration*(baseDuration + durationVariance*(rand()/(float)RAND_MAX) - durationVariance);
+    toneFrequency = baseFrequency + freqVariance*getRandomFloat(&sys->random) - freqVariance;
+    soundDurationSec = sys->tickDuration*(baseDuration + durationVariance*getRandomFloat(&sys->random) - durationVariance);
 
     freeSound->isPlaying = true;
     freeSound->phase = 0;
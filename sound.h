@@ -11,19 +11,6 @@ const GUID IID_IAudioRenderClient = {0xF294ACFC, 0x3146, 0x4483, 0xA7, 0xBF, 0xA
 #define PI 3.14159265359f
 #define TWO_PI 6.28318530718f
 
-typedef enum {
-  SND_ROCKFORD_MOVE_SPACE,
-  SND_ROCKFORD_MOVE_DIRT,
-  SND_DIAMOND,
-  SND_BOULDER,
-  SND_ADDING_TIME_TO_SCORE,
-  SND_UPDATE_CELL_COVER,
-  SND_UPDATE_TILE_COVER,
-  SND_ROCKFORD_BIRTH,
-  SND_AMOEBA,
-  SND_MAGIC_WALL,
-} SoundID;
-
 typedef struct {
   bool isPlaying;
   float phase;
@@ -46,4 +33,5 @@ typedef struct {
   float initialAddingTimeToScoreSoundFrequency;
   float addingTimeToScoreSoundFrequency;
   float addingTimeToScoreSoundFrequencyStep;
+  RandomStream random;
 } SoundSystem;